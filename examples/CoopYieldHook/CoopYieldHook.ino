@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+/**
+ * The example presents Arduino delay() calls turned into cooperative
+ * busy-waits via Arduino core yield() hook. Each thread calls delay() (as it
+ * would be done by a third-party library code) but doesn't block other
+ * threads.
+ *
+ * NOTE: A delaying thread is continuously yielded, so the scheduler spins
+ * and coop_idle_cb() is never called while any thread is delaying (no power
+ * saving). Use coop_idle() instead where the platform shall sleep.
+ *
+ * Required configuration:
+ *     CONFIG_MAX_THREADS >= 2
+ *     CONFIG_ARDUINO_YIELD_HOOK
+ */
+#include "coop_threads.h"
+
+#if ARDUINO_ARCH_AVR
+# define THREAD_STACK_SIZE 0x50U
+#else
+/* use default */
+# define THREAD_STACK_SIZE 0
+#endif
+
+#if CONFIG_MAX_THREADS < 2
+# error CONFIG_MAX_THREADS >= 2 is required
+#endif
+#ifndef CONFIG_ARDUINO_YIELD_HOOK
+# error CONFIG_ARDUINO_YIELD_HOOK need to be configured
+#endif
+
+/*
+ * Thread routine
+ */
+extern "C" void thrd_proc(void *arg)
+{
+    char msg[24] = {};
+    unsigned long period = (unsigned long)(size_t)arg;
+
+    for (int i = 0; i < 5; i++) {
+        sprintf(msg, "%s: %lu\n", coop_thread_name(), millis());
+        Serial.print(msg);
+
+        /* legacy, blocking delay; yields to other threads while busy-waiting */
+        delay(period);
+    }
+    sprintf(msg, "%s EXIT\n", coop_thread_name());
+    Serial.print(msg);
+}
+
+void setup()
+{
+    Serial.begin(115200);
+
+    coop_sched_thread(thrd_proc, "thrd_1", THREAD_STACK_SIZE, (void*)500);
+    coop_sched_thread(thrd_proc, "thrd_2", THREAD_STACK_SIZE, (void*)1000);
+    coop_sched_service();
+}
+
+void loop()
+{
+    static bool info = false;
+    if (!info) {
+        Serial.println("All scheduled threads finished; loop() reached");
+        info = true;
+    }
+    delay(1000);
+}
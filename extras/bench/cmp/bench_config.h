@@ -0,0 +1,22 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+/*
+ * Library configuration the comparative benchmark is built with.
+ */
+
+#define CONFIG_DEFAULT_STACK_SIZE 0x1000U
+
+/* fan-out waiters + coordinator */
+#define CONFIG_MAX_THREADS 65
+
+#define CONFIG_OPT_WAIT
@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+/*
+ * CoopThreads back-end. Each workload is run by a separate scheduler service
+ * run; blocking is implemented by coop_wait()/coop_notify().
+ */
+
+#include <stdbool.h>
+#include "coop_threads.h"
+#include "cmp.h"
+
+#define SEM_PING  1
+#define SEM_PONG  2
+#define SEM_GO    3
+#define SEM_DONE  4
+#define SEM_JOIN  5
+
+static struct
+{
+    unsigned long n;
+    unsigned k;
+
+    bool stop;
+
+    /* ping-pong */
+    int turn;
+
+    /* fan-out */
+    unsigned long gen;
+    unsigned acked;
+
+    /* spawn-join */
+    bool done;
+} ctx;
+
+static void thrd_ping(void *arg)
+{
+    unsigned long i;
+
+    (void)arg;
+    for (i = 0; i < ctx.n; i++)
+    {
+        ctx.turn = 1;
+        coop_notify(SEM_PONG);
+        while (ctx.turn) coop_wait(SEM_PING, 0);
+    }
+    ctx.stop = true;
+    coop_notify(SEM_PONG);
+}
+
+static void thrd_pong(void *arg)
+{
+    (void)arg;
+    for (;;)
+    {
+        while (!ctx.turn && !ctx.stop) coop_wait(SEM_PONG, 0);
+        if (ctx.stop) break;
+
+        ctx.turn = 0;
+        coop_notify(SEM_PING);
+    }
+}
+
+static double coop_ping_pong(unsigned long n)
+{
+    double start;
+
+    ctx.n = n;
+    ctx.stop = false;
+    ctx.turn = 0;
+
+    start = now_ns();
+    coop_sched_thread(thrd_pong, "pong", 0, NULL);
+    coop_sched_thread(thrd_ping, "ping", 0, NULL);
+    coop_sched_service();
+
+    return (now_ns() - start) / n;
+}
+
+static void thrd_waiter(void *arg)
+{
+    unsigned long seen = 0;
+
+    (void)arg;
+    for (;;)
+    {
+        while (ctx.gen == seen && !ctx.stop) coop_wait(SEM_GO, 0);
+        if (ctx.stop) break;
+
+        seen = ctx.gen;
+        if (++ctx.acked == ctx.k) coop_notify(SEM_DONE);
+    }
+}
+
+static void thrd_coord(void *arg)
+{
+    unsigned long i;
+
+    (void)arg;
+    for (i = 0; i < ctx.n; i++)
+    {
+        ctx.acked = 0;
+        ctx.gen++;
+        coop_notify_all(SEM_GO);
+        while (ctx.acked < ctx.k) coop_wait(SEM_DONE, 0);
+    }
+    ctx.stop = true;
+    coop_notify_all(SEM_GO);
+}
+
+static double coop_fan_out(unsigned long n, unsigned k)
+{
+    double start;
+    unsigned i;
+
+    ctx.n = n;
+    ctx.k = k;
+    ctx.stop = false;
+    ctx.gen = 0;
+
+    start = now_ns();
+    for (i = 0; i < k; i++) {
+        coop_sched_thread(thrd_waiter, NULL, 0, NULL);
+    }
+    coop_sched_thread(thrd_coord, "coord", 0, NULL);
+    coop_sched_service();
+
+    return (now_ns() - start) / ((double)n * k);
+}
+
+static void thrd_child(void *arg)
+{
+    (void)arg;
+
+    /* the thread stack is allocated on its first yield (as fibers stacks
+       are allocated by the other back-ends) */
+    coop_yield();
+
+    ctx.done = true;
+    coop_notify(SEM_JOIN);
+}
+
+static void thrd_parent(void *arg)
+{
+    unsigned long i;
+
+    (void)arg;
+    for (i = 0; i < ctx.n; i++)
+    {
+        ctx.done = false;
+        coop_sched_thread(thrd_child, NULL, 0, NULL);
+        while (!ctx.done) coop_wait(SEM_JOIN, 0);
+    }
+}
+
+static double coop_spawn_join(unsigned long n)
+{
+    double start;
+
+    ctx.n = n;
+
+    start = now_ns();
+    coop_sched_thread(thrd_parent, "parent", 0, NULL);
+    coop_sched_service();
+
+    return (now_ns() - start) / n;
+}
+
+const cmp_backend_t bk_coop =
+{
+    "coop", coop_ping_pong, coop_fan_out, coop_spawn_join
+};
@@ -0,0 +1,344 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+/*
+ * Fibers back-end. The fibers are run by a minimal scheduler (FIFO run queue)
+ * switched to by a fiber being blocked or terminated. Blocking is implemented
+ * by wait queues with notify (wakes up the first waiting fiber) and notify-all
+ * operations, as the workloads are run by the other back-ends. The file is
+ * built twice:
+ * - with FIBER_ASM defined: hand-rolled x86-64 context switch (see
+ *   fiber_x86_64.S),
+ * - otherwise: glibc ucontext (swapcontext).
+ *
+ * Fibers stacks are allocated by malloc(3).
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#ifndef FIBER_ASM
+# include <ucontext.h>
+#endif
+#include "cmp.h"
+
+typedef struct fiber
+{
+#ifdef FIBER_ASM
+    void *sp;
+#else
+    ucontext_t uc;
+#endif
+    void (*proc)(void);
+    void *stack;
+    bool done;
+
+    /* run or wait queue link */
+    struct fiber *next;
+} fiber_t;
+
+typedef struct
+{
+    fiber_t *head;
+    fiber_t *tail;
+} fbr_queue_t;
+
+/* scheduler context (main stack) */
+static fiber_t sched_fbr;
+static fiber_t *cur_fbr;
+
+static fbr_queue_t run_q;
+
+#ifdef FIBER_ASM
+/* save callee-saved registers on the current stack, switch to @c to_sp */
+extern void fiber_asm_switch(void **from_sp, void *to_sp);
+#endif
+
+static void fbr_switch(fiber_t *to)
+{
+    fiber_t *from = cur_fbr;
+
+    cur_fbr = to;
+#ifdef FIBER_ASM
+    fiber_asm_switch(&from->sp, to->sp);
+#else
+    swapcontext(&from->uc, &to->uc);
+#endif
+}
+
+static void fbr_enqueue(fbr_queue_t *q, fiber_t *fbr)
+{
+    fbr->next = NULL;
+    if (q->tail) {
+        q->tail->next = fbr;
+    } else {
+        q->head = fbr;
+    }
+    q->tail = fbr;
+}
+
+static fiber_t *fbr_dequeue(fbr_queue_t *q)
+{
+    fiber_t *fbr = q->head;
+
+    if (fbr && !(q->head = fbr->next)) q->tail = NULL;
+    return fbr;
+}
+
+/*
+ * Fiber entry point.
+ */
+static void fbr_entry(void)
+{
+    cur_fbr->proc();
+
+    /* terminated; the stack is freed by the scheduler */
+    cur_fbr->done = true;
+    fbr_switch(&sched_fbr);
+}
+
+/*
+ * Create a fiber running @c proc and put it on the run queue.
+ */
+static void fbr_spawn(fiber_t *fbr, void (*proc)(void))
+{
+    fbr->proc = proc;
+    fbr->stack = malloc(FIBER_STACK_SIZE);
+    fbr->done = false;
+
+#ifdef FIBER_ASM
+    {
+        /* 16-bytes aligned stack top */
+        void **sp = (void**)(((unsigned long)fbr->stack +
+            FIBER_STACK_SIZE) & ~15UL);
+        int i;
+
+        /* fake return address of the entry routine */
+        *--sp = NULL;
+        /* fiber_asm_switch() return address */
+        *--sp = (void*)fbr_entry;
+        /* callee-saved registers */
+        for (i = 0; i < 6; i++) *--sp = NULL;
+
+        fbr->sp = sp;
+    }
+#else
+    getcontext(&fbr->uc);
+    fbr->uc.uc_stack.ss_sp = fbr->stack;
+    fbr->uc.uc_stack.ss_size = FIBER_STACK_SIZE;
+    fbr->uc.uc_link = NULL;
+    makecontext(&fbr->uc, fbr_entry, 0);
+#endif
+    fbr_enqueue(&run_q, fbr);
+}
+
+/*
+ * Run the fibers up to all of them terminated (or blocked).
+ */
+static void fbr_sched(void)
+{
+    fiber_t *fbr;
+
+    cur_fbr = &sched_fbr;
+    while ((fbr = fbr_dequeue(&run_q)) != NULL)
+    {
+        fbr_switch(fbr);
+        if (fbr->done) free(fbr->stack);
+    }
+}
+
+/*
+ * Block the current fiber on wait queue @c wq.
+ */
+static void fbr_wait(fbr_queue_t *wq)
+{
+    fbr_enqueue(wq, cur_fbr);
+    fbr_switch(&sched_fbr);
+}
+
+/*
+ * Wake up the first fiber waiting on @c wq.
+ */
+static void fbr_notify(fbr_queue_t *wq)
+{
+    fiber_t *fbr = fbr_dequeue(wq);
+    if (fbr) fbr_enqueue(&run_q, fbr);
+}
+
+/*
+ * Wake up all fibers waiting on @c wq.
+ */
+static void fbr_notify_all(fbr_queue_t *wq)
+{
+    fiber_t *fbr;
+    while ((fbr = fbr_dequeue(wq)) != NULL) fbr_enqueue(&run_q, fbr);
+}
+
+static struct
+{
+    unsigned long n;
+    unsigned k;
+
+    bool stop;
+
+    /* ping-pong */
+    int turn;
+    fbr_queue_t ping_wq;
+    fbr_queue_t pong_wq;
+
+    /* fan-out */
+    unsigned long gen;
+    unsigned acked;
+    fbr_queue_t go_wq;
+    fbr_queue_t done_wq;
+
+    /* spawn-join */
+    bool done;
+    fbr_queue_t join_wq;
+    fiber_t child;
+} ctx;
+
+static void fbr_ping(void)
+{
+    unsigned long i;
+
+    for (i = 0; i < ctx.n; i++)
+    {
+        ctx.turn = 1;
+        fbr_notify(&ctx.pong_wq);
+        while (ctx.turn) fbr_wait(&ctx.ping_wq);
+    }
+    ctx.stop = true;
+    fbr_notify(&ctx.pong_wq);
+}
+
+static void fbr_pong(void)
+{
+    for (;;)
+    {
+        while (!ctx.turn && !ctx.stop) fbr_wait(&ctx.pong_wq);
+        if (ctx.stop) break;
+
+        ctx.turn = 0;
+        fbr_notify(&ctx.ping_wq);
+    }
+}
+
+static double fbr_ping_pong(unsigned long n)
+{
+    fiber_t ping, pong;
+    double start;
+
+    ctx.n = n;
+    ctx.stop = false;
+    ctx.turn = 0;
+
+    start = now_ns();
+    fbr_spawn(&pong, fbr_pong);
+    fbr_spawn(&ping, fbr_ping);
+    fbr_sched();
+
+    return (now_ns() - start) / n;
+}
+
+static void fbr_waiter(void)
+{
+    unsigned long seen = 0;
+
+    for (;;)
+    {
+        while (ctx.gen == seen && !ctx.stop) fbr_wait(&ctx.go_wq);
+        if (ctx.stop) break;
+
+        seen = ctx.gen;
+        if (++ctx.acked == ctx.k) fbr_notify(&ctx.done_wq);
+    }
+}
+
+static void fbr_coord(void)
+{
+    unsigned long i;
+
+    for (i = 0; i < ctx.n; i++)
+    {
+        ctx.acked = 0;
+        ctx.gen++;
+        fbr_notify_all(&ctx.go_wq);
+        while (ctx.acked < ctx.k) fbr_wait(&ctx.done_wq);
+    }
+    ctx.stop = true;
+    fbr_notify_all(&ctx.go_wq);
+}
+
+static double fbr_fan_out(unsigned long n, unsigned k)
+{
+    fiber_t fbrs[FAN_OUT_MAX + 1];
+    double start;
+    unsigned i;
+
+    ctx.n = n;
+    ctx.k = k;
+    ctx.stop = false;
+    ctx.gen = 0;
+
+    start = now_ns();
+    for (i = 0; i < k; i++) {
+        fbr_spawn(&fbrs[i], fbr_waiter);
+    }
+    fbr_spawn(&fbrs[k], fbr_coord);
+    fbr_sched();
+
+    return (now_ns() - start) / ((double)n * k);
+}
+
+static void fbr_child(void)
+{
+    ctx.done = true;
+    fbr_notify(&ctx.join_wq);
+}
+
+static void fbr_parent(void)
+{
+    unsigned long i;
+
+    for (i = 0; i < ctx.n; i++)
+    {
+        ctx.done = false;
+        fbr_spawn(&ctx.child, fbr_child);
+        while (!ctx.done) fbr_wait(&ctx.join_wq);
+    }
+}
+
+static double fbr_spawn_join(unsigned long n)
+{
+    fiber_t parent;
+    double start;
+
+    ctx.n = n;
+
+    start = now_ns();
+    fbr_spawn(&parent, fbr_parent);
+    fbr_sched();
+
+    return (now_ns() - start) / n;
+}
+
+#ifdef FIBER_ASM
+const cmp_backend_t bk_asm =
+{
+    "asm-fiber", fbr_ping_pong, fbr_fan_out, fbr_spawn_join
+};
+#else
+const cmp_backend_t bk_ucontext =
+{
+    "ucontext", fbr_ping_pong, fbr_fan_out, fbr_spawn_join
+};
+#endif
@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+/*
+ * pthreads back-end. Blocking is implemented by a mutex and condition
+ * variables.
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include "cmp.h"
+
+static struct
+{
+    pthread_mutex_t mtx;
+    pthread_cond_t cond_a;
+    pthread_cond_t cond_b;
+
+    unsigned long n;
+    unsigned k;
+
+    bool stop;
+
+    /* ping-pong */
+    int turn;
+
+    /* fan-out */
+    unsigned long gen;
+    unsigned acked;
+} ctx = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+    PTHREAD_COND_INITIALIZER };
+
+static void *thrd_pong(void *arg)
+{
+    (void)arg;
+    pthread_mutex_lock(&ctx.mtx);
+    for (;;)
+    {
+        while (!ctx.turn && !ctx.stop) pthread_cond_wait(&ctx.cond_b, &ctx.mtx);
+        if (ctx.stop) break;
+
+        ctx.turn = 0;
+        pthread_cond_signal(&ctx.cond_a);
+    }
+    pthread_mutex_unlock(&ctx.mtx);
+    return NULL;
+}
+
+static double pthread_ping_pong(unsigned long n)
+{
+    pthread_t thrd;
+    unsigned long i;
+    double start;
+
+    ctx.stop = false;
+    ctx.turn = 0;
+
+    start = now_ns();
+    pthread_create(&thrd, NULL, thrd_pong, NULL);
+
+    pthread_mutex_lock(&ctx.mtx);
+    for (i = 0; i < n; i++)
+    {
+        ctx.turn = 1;
+        pthread_cond_signal(&ctx.cond_b);
+        while (ctx.turn) pthread_cond_wait(&ctx.cond_a, &ctx.mtx);
+    }
+    ctx.stop = true;
+    pthread_cond_signal(&ctx.cond_b);
+    pthread_mutex_unlock(&ctx.mtx);
+
+    pthread_join(thrd, NULL);
+    return (now_ns() - start) / n;
+}
+
+static void *thrd_waiter(void *arg)
+{
+    unsigned long seen = 0;
+
+    (void)arg;
+    pthread_mutex_lock(&ctx.mtx);
+    for (;;)
+    {
+        while (ctx.gen == seen && !ctx.stop) {
+            pthread_cond_wait(&ctx.cond_b, &ctx.mtx);
+        }
+        if (ctx.stop) break;
+
+        seen = ctx.gen;
+        if (++ctx.acked == ctx.k) pthread_cond_signal(&ctx.cond_a);
+    }
+    pthread_mutex_unlock(&ctx.mtx);
+    return NULL;
+}
+
+static double pthread_fan_out(unsigned long n, unsigned k)
+{
+    pthread_t thrds[FAN_OUT_MAX];
+    unsigned long i;
+    double start;
+
+    ctx.k = k;
+    ctx.stop = false;
+    ctx.gen = 0;
+
+    start = now_ns();
+    for (i = 0; i < k; i++) {
+        pthread_create(&thrds[i], NULL, thrd_waiter, NULL);
+    }
+
+    pthread_mutex_lock(&ctx.mtx);
+    for (i = 0; i < n; i++)
+    {
+        ctx.acked = 0;
+        ctx.gen++;
+        pthread_cond_broadcast(&ctx.cond_b);
+        while (ctx.acked < k) pthread_cond_wait(&ctx.cond_a, &ctx.mtx);
+    }
+    ctx.stop = true;
+    pthread_cond_broadcast(&ctx.cond_b);
+    pthread_mutex_unlock(&ctx.mtx);
+
+    for (i = 0; i < k; i++) {
+        pthread_join(thrds[i], NULL);
+    }
+    return (now_ns() - start) / ((double)n * k);
+}
+
+static void *thrd_child(void *arg)
+{
+    return arg;
+}
+
+static double pthread_spawn_join(unsigned long n)
+{
+    pthread_t thrd;
+    unsigned long i;
+    double start = now_ns();
+
+    for (i = 0; i < n; i++) {
+        pthread_create(&thrd, NULL, thrd_child, NULL);
+        pthread_join(thrd, NULL);
+    }
+    return (now_ns() - start) / n;
+}
+
+const cmp_backend_t bk_pthread =
+{
+    "pthread", pthread_ping_pong, pthread_fan_out, pthread_spawn_join
+};
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+/*
+ * Comparative benchmark.
+ *
+ * Identical ping-pong, fan-out notify and spawn/join workloads are run on
+ * CoopThreads, glibc ucontext (swapcontext), pthreads (mutex + condvars) and
+ * a minimal hand-rolled x86-64 asm fiber (if supported by the platform).
+ * The results are printed as a comparison table of per-operation costs.
+ *
+ * Usage: cmp [-n iterations] [-k fan-out waiters]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "cmp.h"
+
+extern const cmp_backend_t bk_coop;
+extern const cmp_backend_t bk_ucontext;
+extern const cmp_backend_t bk_pthread;
+#ifdef __x86_64__
+extern const cmp_backend_t bk_asm;
+#endif
+
+static const cmp_backend_t *backends[] =
+{
+    &bk_coop,
+    &bk_ucontext,
+    &bk_pthread,
+#ifdef __x86_64__
+    &bk_asm,
+#endif
+};
+
+#define BACKENDS_N (sizeof(backends) / sizeof(backends[0]))
+
+int main(int argc, char *argv[])
+{
+    unsigned long n = 100000;
+    unsigned k = 16, i;
+    double res[3][BACKENDS_N];
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:k:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            n = strtoul(optarg, NULL, 0);
+            break;
+        case 'k':
+            k = (unsigned)strtoul(optarg, NULL, 0);
+            break;
+        default:
+            fprintf(stderr,
+                "Usage: %s [-n iterations] [-k fan-out waiters]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (!n || !k || k > FAN_OUT_MAX) {
+        fprintf(stderr, "Invalid arguments (max fan-out waiters: %d)\n",
+            FAN_OUT_MAX);
+        return 1;
+    }
+
+    for (i = 0; i < BACKENDS_N; i++) {
+        res[0][i] = backends[i]->ping_pong(n);
+        res[1][i] = backends[i]->fan_out(n / k + 1, k);
+        res[2][i] = backends[i]->spawn_join(n);
+    }
+
+    printf("iterations: %lu, fan-out waiters: %u; cost per operation [ns]\n\n",
+        n, k);
+
+    printf("%-12s", "workload");
+    for (i = 0; i < BACKENDS_N; i++) printf("%12s", backends[i]->name);
+    printf("\n");
+
+    for (opt = 0; opt < 3; opt++)
+    {
+        static const char *workloads[] =
+            { "ping-pong", "fan-out", "spawn-join" };
+
+        printf("%-12s", workloads[opt]);
+        for (i = 0; i < BACKENDS_N; i++) printf("%12.1f", res[opt][i]);
+        printf("\n");
+    }
+
+    return 0;
+}
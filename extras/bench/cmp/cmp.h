@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+/*
+ * Comparative benchmark: workloads implemented by each of the compared
+ * threading back-ends.
+ */
+
+#ifndef __CMP_H__
+#define __CMP_H__
+
+#include <time.h>
+
+/* max number of fan-out waiters */
+#define FAN_OUT_MAX 64
+
+/* stack size of fibers (ucontext, asm) */
+#define FIBER_STACK_SIZE 0x4000U
+
+typedef struct
+{
+    const char *name;
+
+    /*
+     * Workloads; each returns the average cost of a single operation [ns].
+     */
+
+    /* @c n round-trips between two threads */
+    double (*ping_pong)(unsigned long n);
+
+    /* @c n rounds of a coordinator waking up @c k waiting threads */
+    double (*fan_out)(unsigned long n, unsigned k);
+
+    /* @c n times spawn a thread and join it */
+    double (*spawn_join)(unsigned long n);
+} cmp_backend_t;
+
+static inline double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+#endif /* __CMP_H__ */
@@ -0,0 +1,25 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+/*
+ * Library configuration the coop-echo server is built with.
+ */
+
+#define CONFIG_DEFAULT_STACK_SIZE 0x2000U
+
+/* listener + connection threads */
+#define CONFIG_MAX_THREADS 257
+
+#define CONFIG_OPT_IDLE
+#define CONFIG_OPT_WAIT
+#define CONFIG_OPT_WAIT_POLL
+#define CONFIG_UNIX_SYSCALL_WRAP
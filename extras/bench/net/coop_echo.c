@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+/*
+ * coop-echo: TCP echo/HTTP server running one coop thread per connection.
+ *
+ * Blocking accept(2)/read(2)/write(2) calls switch the calling thread into
+ * the waiting state up to the descriptor readiness (see unix_wrap.c). The
+ * server sleeps in poll(2) on all the connections descriptors while no thread
+ * is ready to run.
+ */
+
+#include "proto.h"
+#include "coop_threads.h"
+
+static int http;
+
+static void thrd_conn(void *arg)
+{
+    serve_conn((int)(intptr_t)arg, http);
+}
+
+static void thrd_listener(void *arg)
+{
+    int lfd = (int)(intptr_t)arg, fd;
+
+    while ((fd = accept(lfd, NULL, NULL)) >= 0)
+    {
+        set_nodelay(fd);
+        if (coop_sched_thread(thrd_conn, "conn", 0, (void*)(intptr_t)fd) !=
+            COOP_SUCCESS)
+        {
+            /* threads limit reached */
+            close(fd);
+        }
+    }
+    perror("accept");
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned short port;
+
+    parse_args(argc, argv, &port, &http);
+
+    coop_sched_thread(thrd_listener, "listener", 0,
+        (void*)(intptr_t)listen_on(port));
+    coop_sched_service();
+
+    return 0;
+}
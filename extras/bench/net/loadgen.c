@@ -0,0 +1,260 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+/*
+ * loadgen: loopback load generator for the benchmark servers.
+ *
+ * Opens the requested number of connections and drives them by request/
+ * response ping-pongs (one client pthread per connection) for the requested
+ * time. Reports requests/s, p50/p99 latency and the server memory usage per
+ * connection (resident set size increase after the connections were
+ * established; the server process id is required).
+ */
+
+#define _GNU_SOURCE /* memmem() */
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define HTTP_REQ "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n"
+
+typedef struct
+{
+    pthread_t thrd;
+    int fd;
+
+    /* latency samples (usecs) */
+    unsigned *lat;
+    size_t n, sz;
+} client_t;
+
+static struct
+{
+    unsigned short port;
+    unsigned conns;
+    unsigned secs;
+    size_t msg_sz;
+    int http;
+    long pid;
+} cfg = { 9000, 64, 5, 64, 0, 0 };
+
+static volatile int stop = 0;
+
+static unsigned long long now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000U;
+}
+
+/*
+ * Resident set size (kB) of process @c pid or 0 if not available.
+ */
+static unsigned long rss_kb(long pid)
+{
+    char path[64], line[128];
+    unsigned long rss = 0;
+    FILE *f;
+
+    snprintf(path, sizeof(path), "/proc/%ld/status", pid);
+    if (!(f = fopen(path, "r"))) return 0;
+
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "VmRSS: %lu", &rss) == 1) break;
+    }
+    fclose(f);
+    return rss;
+}
+
+static int connect_to(unsigned short port)
+{
+    struct sockaddr_in addr;
+    int fd, on = 1;
+
+    if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) return -1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    return fd;
+}
+
+/*
+ * Receive response; return 0 on success.
+ */
+static int recv_resp(int fd, char *buf, size_t buf_sz, size_t exp_len)
+{
+    size_t len = 0;
+    ssize_t n;
+
+    while (len < buf_sz)
+    {
+        if ((n = read(fd, buf + len, buf_sz - len)) <= 0) return -1;
+        len += (size_t)n;
+
+        if (exp_len) {
+            if (len >= exp_len) return 0;
+        } else {
+            /* HTTP response with "ok" body */
+            char *end = memmem(buf, len, "\r\n\r\n", 4);
+            if (end && (size_t)(buf + len - end) >= 4 + 2) return 0;
+        }
+    }
+    return -1;
+}
+
+static void *client(void *arg)
+{
+    client_t *cl = (client_t*)arg;
+    const char *req;
+    size_t req_len;
+    char *msg, resp[1024];
+
+    if (cfg.http) {
+        req = HTTP_REQ;
+        req_len = sizeof(HTTP_REQ) - 1;
+        msg = NULL;
+    } else {
+        if (!(msg = malloc(cfg.msg_sz))) return NULL;
+        memset(msg, 'x', cfg.msg_sz);
+        req = msg;
+        req_len = cfg.msg_sz;
+    }
+
+    while (!stop)
+    {
+        unsigned long long start = now_us();
+
+        if (write(cl->fd, req, req_len) != (ssize_t)req_len ||
+            recv_resp(cl->fd, resp, sizeof(resp), (cfg.http ? 0 : req_len)))
+        {
+            fprintf(stderr, "Connection error\n");
+            break;
+        }
+
+        if (cl->n >= cl->sz) {
+            cl->sz = (cl->sz ? 2 * cl->sz : 1024);
+            if (!(cl->lat = realloc(cl->lat, cl->sz * sizeof(*cl->lat)))) {
+                break;
+            }
+        }
+        cl->lat[cl->n++] = (unsigned)(now_us() - start);
+    }
+
+    free(msg);
+    return NULL;
+}
+
+static int cmp_u(const void *a, const void *b)
+{
+    unsigned ua = *(const unsigned*)a, ub = *(const unsigned*)b;
+    return (ua < ub ? -1 : (ua > ub));
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-p port] [-c conns] [-d secs] [-s msg_size] "
+        "[-H] [-P server_pid]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long rss_base = 0, rss_conn = 0;
+    unsigned *lat, i;
+    client_t *cls;
+    size_t n = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:c:d:s:HP:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'p': cfg.port = (unsigned short)atoi(optarg); break;
+        case 'c': cfg.conns = (unsigned)atoi(optarg); break;
+        case 'd': cfg.secs = (unsigned)atoi(optarg); break;
+        case 's': cfg.msg_sz = (size_t)atoi(optarg); break;
+        case 'H': cfg.http = 1; break;
+        case 'P': cfg.pid = atol(optarg); break;
+        default: usage(argv[0]);
+        }
+    }
+    if (!cfg.conns || !cfg.msg_sz || cfg.msg_sz > 1024) usage(argv[0]);
+
+    if (!(cls = calloc(cfg.conns, sizeof(*cls)))) return 1;
+
+    if (cfg.pid) rss_base = rss_kb(cfg.pid);
+
+    for (i = 0; i < cfg.conns; i++) {
+        if ((cls[i].fd = connect_to(cfg.port)) < 0) {
+            perror("connect");
+            return 1;
+        }
+    }
+
+    if (cfg.pid) {
+        /* let the server start the connection handlers */
+        usleep(200000);
+        rss_conn = rss_kb(cfg.pid);
+    }
+
+    for (i = 0; i < cfg.conns; i++) {
+        if (pthread_create(&cls[i].thrd, NULL, client, &cls[i])) {
+            perror("pthread_create");
+            return 1;
+        }
+    }
+
+    sleep(cfg.secs);
+    stop = 1;
+
+    for (i = 0; i < cfg.conns; i++) {
+        pthread_join(cls[i].thrd, NULL);
+        n += cls[i].n;
+    }
+
+    if (!(lat = malloc((n ? n : 1) * sizeof(*lat)))) return 1;
+    for (i = 0, n = 0; i < cfg.conns; i++) {
+        memcpy(lat + n, cls[i].lat, cls[i].n * sizeof(*lat));
+        n += cls[i].n;
+        close(cls[i].fd);
+    }
+    qsort(lat, n, sizeof(*lat), cmp_u);
+
+    printf("connections: %u, mode: %s, duration: %us\n", cfg.conns,
+        (cfg.http ? "http" : "echo"), cfg.secs);
+    printf("requests/s: %.0f\n", (double)n / cfg.secs);
+    if (n) {
+        printf("latency p50: %u us, p99: %u us\n",
+            lat[(n - 1) * 50 / 100], lat[(n - 1) * 99 / 100]);
+    }
+    if (cfg.pid && rss_conn) {
+        printf("server memory per connection: %.1f kB\n",
+            (rss_conn > rss_base ? (double)(rss_conn - rss_base) : 0.0) /
+            cfg.conns);
+    }
+    return 0;
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+/*
+ * Echo/HTTP protocol handling common for the benchmark servers. Blocking
+ * read(2)/write(2) calls are made cooperative for coop-echo by the library
+ * system calls interposition layer.
+ */
+
+#ifndef __PROTO_H__
+#define __PROTO_H__
+
+#define _GNU_SOURCE /* memmem() */
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define DEF_PORT 9000
+#define BUF_SZ 1024
+
+#define HTTP_RESP \
+    "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 2\r\n\r\nok"
+
+static int write_all(int fd, const char *buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n <= 0) return -1;
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/*
+ * Serve connection @c fd: echo received data back or respond to each HTTP
+ * request (header terminated by an empty line) with a fixed response.
+ */
+static void serve_conn(int fd, int http)
+{
+    char buf[BUF_SZ];
+    size_t len = 0;
+    ssize_t n;
+
+    while ((n = read(fd, buf + len, sizeof(buf) - len)) > 0)
+    {
+        char *end;
+
+        if (!http) {
+            if (write_all(fd, buf, (size_t)n)) break;
+            continue;
+        }
+
+        len += (size_t)n;
+        while ((end = memmem(buf, len, "\r\n\r\n", 4)) != NULL)
+        {
+            size_t req_len = (size_t)(end - buf) + 4;
+
+            if (write_all(fd, HTTP_RESP, sizeof(HTTP_RESP) - 1)) goto finish;
+            memmove(buf, buf + req_len, len - req_len);
+            len -= req_len;
+        }
+        /* request header too long */
+        if (len == sizeof(buf)) break;
+    }
+finish:
+    close(fd);
+}
+
+/*
+ * Create listening socket on the loopback interface.
+ */
+static int listen_on(unsigned short port)
+{
+    struct sockaddr_in addr;
+    int fd, on = 1;
+
+    if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+        perror("socket");
+        exit(1);
+    }
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+        listen(fd, 1024) < 0)
+    {
+        perror("bind/listen");
+        exit(1);
+    }
+    return fd;
+}
+
+static void set_nodelay(int fd)
+{
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-p port] [-H]\n"
+        "  -p  listening port (default: %d)\n"
+        "  -H  HTTP mode (default: echo)\n", prog, DEF_PORT);
+    exit(1);
+}
+
+static void parse_args(int argc, char *argv[], unsigned short *port, int *http)
+{
+    int opt;
+
+    *port = DEF_PORT;
+    *http = 0;
+
+    while ((opt = getopt(argc, argv, "p:H")) != -1)
+    {
+        switch (opt)
+        {
+        case 'p':
+            *port = (unsigned short)atoi(optarg);
+            break;
+        case 'H':
+            *http = 1;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+}
+
+#endif /* __PROTO_H__ */
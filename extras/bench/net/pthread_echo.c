@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+/*
+ * pthread-echo: baseline TCP echo/HTTP server running one pthread per
+ * connection.
+ */
+
+#include "proto.h"
+#include <pthread.h>
+
+/* connection thread stack size */
+#define STACK_SZ 0x10000
+
+static int http;
+
+static void *thrd_conn(void *arg)
+{
+    serve_conn((int)(intptr_t)arg, http);
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned short port;
+    pthread_attr_t attr;
+    pthread_t thrd;
+    int lfd, fd;
+
+    parse_args(argc, argv, &port, &http);
+    lfd = listen_on(port);
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_attr_setstacksize(&attr, STACK_SZ);
+
+    while ((fd = accept(lfd, NULL, NULL)) >= 0)
+    {
+        set_nodelay(fd);
+        if (pthread_create(&thrd, &attr, thrd_conn, (void*)(intptr_t)fd)) {
+            close(fd);
+        }
+    }
+    perror("accept");
+
+    return 1;
+}
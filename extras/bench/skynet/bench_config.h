@@ -0,0 +1,25 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+/*
+ * Library configuration the skynet benchmark is built with.
+ */
+
+#define CONFIG_DEFAULT_STACK_SIZE 0x2000U
+
+#ifndef CONFIG_MAX_THREADS
+# define CONFIG_MAX_THREADS 256
+#endif
+
+#define CONFIG_OPT_WAIT
+#define CONFIG_OPT_WAIT_ADDR
+#define CONFIG_WAIT_ADDR_BUCKETS 64
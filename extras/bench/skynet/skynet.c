@@ -0,0 +1,306 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+/*
+ * skynet: spawn-heavy benchmark.
+ *
+ * A tree of threads is spawned recursively (@c branch children per node)
+ * down to @c total leaves. Each leaf returns its number, each node joins its
+ * children and sums their results. The root result is the sum of numbers
+ * 0..total-1.
+ *
+ * Since the threads pool is bounded (CONFIG_MAX_THREADS), a node failing to
+ * spawn a child blocks up to a pool slot is freed. The threads stacks are
+ * allocated on the main stack in the threads start order, therefore a slot
+ * of a terminated thread is freed after all the threads started later have
+ * terminated. To prevent the pool exhaustion by nodes waiting for slots
+ * (deadlock), a child is spawned only if the free slots suffice (one slot per
+ * subtree level) for the child subtree and for the subtrees of already
+ * spawned, not yet started threads to be completed on their own.
+ *
+ * spawns/s are calculated over the time spent in the spawning calls only,
+ * excluding the threads running, joining and waiting for free slots.
+ *
+ * Usage: skynet [-n total] [-b branch]
+ */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "coop_threads.h"
+
+#define BRANCH_MAX 16
+
+#define ARRAY_SIZE(_a) (sizeof(_a) / sizeof((_a)[0]))
+
+typedef struct node
+{
+    struct node *parent;
+    unsigned long long num;
+    unsigned long size;
+
+    /* number of the subtree levels below the node */
+    unsigned height;
+
+    /* thread stack depth on the main stack */
+    unsigned depth;
+
+    /* children results */
+    unsigned long long sum;
+
+    /* number of running children threads */
+    int pending;
+} node_t;
+
+static unsigned long branch = 10;
+
+/* threads pool slots state */
+static struct
+{
+    /* number of free slots */
+    unsigned free;
+
+    /* slots reserved for subtrees of not yet started threads */
+    unsigned rsvd;
+
+    /* main stack depth and terminated threads on each its level */
+    unsigned depth;
+    bool done[CONFIG_MAX_THREADS + 1];
+
+    /*
+     * Slot-free notification addresses: nodes spawning a child of height
+     * @c h wait on wq[h].
+     */
+    int wq[32];
+} slots = { CONFIG_MAX_THREADS };
+
+static struct
+{
+    unsigned long spawns;   /* spawned threads */
+    double spawn_secs;      /* time spent in the spawning calls */
+} stats;
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * A child of height @c h may be spawned.
+ */
+static bool slots_avail(unsigned h)
+{
+    return (slots.free > slots.rsvd + h);
+}
+
+/*
+ * Notify nodes which may spawn their children now.
+ */
+static void slots_notify(void)
+{
+    unsigned h;
+
+    for (h = 0; h < ARRAY_SIZE(slots.wq) && slots_avail(h); h++) {
+        coop_wake_addr(&slots.wq[h], 0);
+    }
+}
+
+/*
+ * Thread of node @c nd started; its stack is placed on top of the main stack.
+ */
+static void slots_start(node_t *nd)
+{
+    nd->depth = ++slots.depth;
+    slots.done[nd->depth] = false;
+
+    if (nd->parent) {
+        slots.rsvd -= nd->height;
+        slots_notify();
+    }
+}
+
+/*
+ * Thread of node @c nd is terminating. Slots of the terminated threads are
+ * freed up to the top-most still running one.
+ */
+static void slots_term(node_t *nd)
+{
+    slots.done[nd->depth] = true;
+
+    if (nd->depth == slots.depth) {
+        for (; slots.depth && slots.done[slots.depth]; slots.depth--) {
+            slots.free++;
+        }
+        slots_notify();
+    }
+}
+
+static unsigned long long node_calc(node_t *nd);
+
+static void thrd_node(void *arg)
+{
+    node_t *nd = (node_t*)arg;
+    unsigned long long res;
+
+    slots_start(nd);
+    res = node_calc(nd);
+
+    nd->parent->sum += res;
+    nd->parent->pending--;
+    coop_wake_addr(&nd->parent->pending, 1);
+    slots_term(nd);
+}
+
+/*
+ * Spawn thread of node @c chld; block up to the pool slots are available.
+ */
+static void spawn(node_t *chld)
+{
+    double start;
+    coop_error_t ret;
+
+    while (!slots_avail(chld->height)) {
+        coop_wait_addr(&slots.wq[chld->height], 0, 0);
+    }
+
+    start = now_sec();
+    ret = coop_sched_thread(thrd_node, NULL, 0, chld);
+    stats.spawn_secs += now_sec() - start;
+
+    assert(ret == COOP_SUCCESS);
+    (void)ret;
+
+    slots.free--;
+    slots.rsvd += chld->height;
+    stats.spawns++;
+}
+
+static unsigned long long node_calc(node_t *nd)
+{
+    node_t chld[BRANCH_MAX];
+    unsigned long i, step;
+
+    if (nd->size <= 1) {
+        return nd->num;
+    }
+
+    nd->sum = 0;
+    nd->pending = 0;
+    step = nd->size / branch;
+
+    for (i = 0; i < branch; i++)
+    {
+        chld[i].parent = nd;
+        chld[i].num = nd->num + i * step;
+        chld[i].size = step;
+        chld[i].height = nd->height - 1;
+
+        spawn(&chld[i]);
+        nd->pending++;
+    }
+
+    /* join the children */
+    while (nd->pending) {
+        coop_wait_addr(&nd->pending, nd->pending, 0);
+    }
+    return nd->sum;
+}
+
+static void thrd_root(void *arg)
+{
+    node_t *nd = (node_t*)arg;
+
+    slots_start(nd);
+    nd->sum = node_calc(nd);
+}
+
+/*
+ * Peak resident set size (kB) or 0 if not available.
+ */
+static unsigned long peak_rss_kb(void)
+{
+    char line[128];
+    unsigned long rss = 0;
+    FILE *f;
+
+    if (!(f = fopen("/proc/self/status", "r"))) return 0;
+
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "VmHWM: %lu", &rss) == 1) break;
+    }
+    fclose(f);
+    return rss;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long total = 1000000, n;
+    node_t root;
+    double start, secs;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:b:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            total = strtoul(optarg, NULL, 0);
+            break;
+        case 'b':
+            branch = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-n total] [-b branch]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    memset(&root, 0, sizeof(root));
+    root.size = total;
+
+    for (n = 1; n < total; n *= branch) root.height++;
+    if (branch < 2 || branch > BRANCH_MAX || n != total) {
+        fprintf(stderr, "total must be a power of branch (2..%d)\n",
+            BRANCH_MAX);
+        return 1;
+    }
+
+    if (root.height >= CONFIG_MAX_THREADS ||
+        root.height >= ARRAY_SIZE(slots.wq))
+    {
+        fprintf(stderr, "tree too high for the threads pool\n");
+        return 1;
+    }
+
+    start = now_sec();
+    coop_sched_thread(thrd_root, "root", 0, &root);
+    slots.free--;
+    coop_sched_service();
+    secs = now_sec() - start;
+
+    assert(root.sum == (unsigned long long)total * (total - 1) / 2);
+
+    printf("result: %llu\n", root.sum);
+    printf("threads pool: %u, spawned: %lu\n",
+        CONFIG_MAX_THREADS, stats.spawns + 1);
+    printf("time: %.3f s, spawn time: %.3f s, spawns/s: %.0f\n",
+        secs, stats.spawn_secs, stats.spawns / stats.spawn_secs);
+    printf("peak memory: %lu kB\n", peak_rss_kb());
+
+    return 0;
+}
@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+/*
+ * coop-top: live view of the statistics exported by a process running the
+ * library scheduler (see coop_stats_shm_export()).
+ *
+ * Usage: coop-top [-d msecs] [-n count] [shm_name]
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "coop_stats.h"
+
+/* max number of seqlock read retries */
+#define MAX_RETRIES 1000
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-d msecs] [-n count] [shm_name]\n"
+        "  -d  refresh period in msecs (default: 1000)\n"
+        "  -n  number of refreshes; 0 for infinite (default)\n"
+        "  shm_name  shared memory segment name (default: %s)\n",
+        prog, COOP_STATS_SHM_NAME);
+}
+
+/*
+ * Copy consistent statistics snapshot. Return 0 on success.
+ */
+static int snapshot(const coop_stats_exp_t *exp, coop_stats_exp_t *snap,
+    size_t size)
+{
+    uint32_t seq;
+    int i;
+
+    for (i = 0; i < MAX_RETRIES; i++)
+    {
+        seq = exp->seq;
+        __sync_synchronize();
+
+        if (!(seq & 1)) {
+            memcpy(snap, exp, size);
+            __sync_synchronize();
+            if (exp->seq == seq) return 0;
+        }
+        usleep(100);
+    }
+    return -1;
+}
+
+static const char *state_name(uint8_t state)
+{
+    static const char *names[] = {
+        [COOP_STATS_EMPTY] = "EMPTY",
+        [COOP_STATS_NEW] = "NEW",
+        [COOP_STATS_RUN] = "RUN",
+        [COOP_STATS_IDLE] = "IDLE",
+        [COOP_STATS_WAIT] = "WAIT",
+        [COOP_STATS_HOLE] = "HOLE"
+    };
+    return (state < sizeof(names)/sizeof(names[0]) ? names[state] : "???");
+}
+
+static void print_wait(const coop_stats_exp_thrd_t *thrd)
+{
+    if (thrd->state != COOP_STATS_WAIT) {
+        printf("%-18s", "-");
+    } else
+    if (thrd->wait_obj) {
+        printf("0x%-16llx", (unsigned long long)thrd->wait_obj);
+    } else {
+        printf("sem:%-14d", (int)thrd->wait_sem);
+    }
+}
+
+static void print(const coop_stats_exp_t *cur, const coop_stats_exp_t *prev)
+{
+    uint32_t dt = (prev ? cur->tick - prev->tick : 0);
+    uint32_t i;
+
+    printf("\033[H\033[J");
+    printf("threads: %u/%u  switches: %u (+%u)  idle: %u (+%u)  tick: %u\n\n",
+        cur->busy_n, cur->thrds_n,
+        cur->switch_n, (prev ? cur->switch_n - prev->switch_n : 0),
+        cur->idle_n, (prev ? cur->idle_n - prev->idle_n : 0), cur->tick);
+
+    printf("%3s %-16s %-6s %6s %10s %10s %8s %-18s %8s %8s\n",
+        "#", "NAME", "STATE", "RUN%", "RUN", "SWITCH", "STACK",
+        "WAIT", "MEM", "MEMPEAK");
+
+    for (i = 0; i < cur->thrds_n; i++)
+    {
+        const coop_stats_exp_thrd_t *thrd = &cur->thrds[i];
+        double run = 0.0;
+
+        if (thrd->state == COOP_STATS_EMPTY) continue;
+
+        if (dt && prev && !strcmp(prev->thrds[i].name, thrd->name) &&
+            thrd->run_ticks >= prev->thrds[i].run_ticks)
+        {
+            run = 100.0 * (thrd->run_ticks - prev->thrds[i].run_ticks) / dt;
+        }
+
+        printf("%3u %-16s %-6s %6.1f %10u %10u %8u ", i,
+            (thrd->name[0] ? thrd->name : "-"), state_name(thrd->state), run,
+            thrd->run_ticks, thrd->switch_n, thrd->stack_wm);
+        print_wait(thrd);
+        printf(" %8llu %8llu\n", (unsigned long long)thrd->mem_cur,
+            (unsigned long long)thrd->mem_peak);
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *name = COOP_STATS_SHM_NAME;
+    unsigned delay = 1000, count = 0, n;
+    coop_stats_exp_t *exp, *snap[2];
+    struct stat st;
+    size_t size;
+    int opt, fd;
+
+    while ((opt = getopt(argc, argv, "d:n:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'd':
+            delay = (unsigned)strtoul(optarg, NULL, 0);
+            break;
+        case 'n':
+            count = (unsigned)strtoul(optarg, NULL, 0);
+            break;
+        default:
+            usage(argv[0]);
+            return (opt == 'h' ? 0 : 1);
+        }
+    }
+    if (optind < argc) name = argv[optind];
+
+    if ((fd = shm_open(name, O_RDONLY, 0)) < 0) {
+        perror(name);
+        return 1;
+    }
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(coop_stats_exp_t)) {
+        fprintf(stderr, "%s: invalid statistics segment\n", name);
+        return 1;
+    }
+    size = (size_t)st.st_size;
+
+    exp = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (exp == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    if (exp->magic != COOP_STATS_MAGIC ||
+        COOP_STATS_EXP_SIZE(exp->thrds_n) > size)
+    {
+        fprintf(stderr, "%s: invalid statistics segment\n", name);
+        return 1;
+    }
+    size = COOP_STATS_EXP_SIZE(exp->thrds_n);
+
+    snap[0] = malloc(size);
+    snap[1] = malloc(size);
+    if (!snap[0] || !snap[1]) {
+        perror("malloc");
+        return 1;
+    }
+
+    for (n = 0; !count || n < count; n++)
+    {
+        if (n) usleep(delay * 1000U);
+
+        if (snapshot(exp, snap[n & 1], size)) {
+            fprintf(stderr, "%s: statistics snapshot failed\n", name);
+            return 1;
+        }
+        print(snap[n & 1], (n ? snap[(n - 1) & 1] : NULL));
+    }
+    return 0;
+}
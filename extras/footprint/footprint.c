@@ -0,0 +1,22 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+/*
+ * Internal library structures sizes. The library source is included to access
+ * its private types; the sizes are read from the symbols sizes (nm -S) so
+ * they are available for cross-compiled objects either.
+ */
+
+#include "coop_threads.c"
+
+const char fp_thrd_ctx[sizeof(coop_thrd_ctx_t)] = {0};
+const char fp_sched_ctx[sizeof(coop_sched_ctx_t)] = {0};
@@ -0,0 +1,74 @@
+#!/bin/sh
+#
+# Report the library footprint for every combination of the examined features.
+#
+# Usage: footprint.sh [CC [CFLAGS]]
+#
+# CC defaults to cc, CFLAGS to -Os. Binutils tools (size, nm) are taken with
+# the same prefix as CC (e.g. avr-gcc -> avr-size, avr-nm).
+#
+
+CC=${1:-cc}
+CFLAGS=${2:--Os}
+
+LIBDIR=../../src
+OPTS="CONFIG_OPT_IDLE CONFIG_OPT_WAIT CONFIG_OPT_YIELD_AFTER CONFIG_OPT_STACK_WM
+CONFIG_NOEXIT_STATIC_THREADS"
+
+case "$CC" in
+*-*) PREFIX="${CC%-*}-";;
+*) PREFIX="";;
+esac
+SIZE=${PREFIX}size
+NM=${PREFIX}nm
+
+TMPDIR=$(mktemp -d) || exit 1
+trap 'rm -rf $TMPDIR' EXIT
+
+COMPILE="$CC $CFLAGS -c -I$LIBDIR -I. \
+-DCOOP_CONFIG_FILE=\"footprint_config.h\""
+
+# symbol size (decimal) from nm -S output
+sym_size()
+{
+    $NM -S -t d "$1" | awk -v sym="$2" '$4 == sym { print $2 + 0 }'
+}
+
+printf "%-6s %-6s %-6s %-6s %-6s %7s %7s %7s %9s %9s\n" \
+    IDLE WAIT YIELD STK_WM NOEXIT text data bss thrd_ctx sched_ctx
+
+n=$(echo $OPTS | wc -w)
+combs=$((1 << n))
+c=0
+while [ $c -lt $combs ]
+do
+    defs=""
+    flags=""
+    i=0
+    for o in $OPTS; do
+        if [ $((c >> i & 1)) -eq 1 ]; then
+            defs="$defs -D$o"
+            flags="$flags x"
+        else
+            flags="$flags -"
+        fi
+        i=$((i + 1))
+    done
+
+    if ! $COMPILE $defs $LIBDIR/coop_threads.c -o $TMPDIR/lib.o ||
+       ! $COMPILE $defs footprint.c -o $TMPDIR/fp.o
+    then
+        echo "Build failed for:$defs" >&2
+        exit 1
+    fi
+
+    set -- $($SIZE $TMPDIR/lib.o | tail -n 1)
+    text=$1 data=$2 bss=$3
+
+    printf "%-6s %-6s %-6s %-6s %-6s %7s %7s %7s %9s %9s\n" $flags \
+        $text $data $bss \
+        $(sym_size $TMPDIR/fp.o fp_thrd_ctx) \
+        $(sym_size $TMPDIR/fp.o fp_sched_ctx)
+
+    c=$((c + 1))
+done
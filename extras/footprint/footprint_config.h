@@ -0,0 +1,20 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+/*
+ * Library configuration the footprint report is built with. The examined
+ * features (CONFIG_OPT_*, CONFIG_NOEXIT_STATIC_THREADS) are defined by the
+ * footprint.sh script on the compiler command line.
+ */
+
+#define CONFIG_DEFAULT_STACK_SIZE 0x100U
+#define CONFIG_MAX_THREADS 5
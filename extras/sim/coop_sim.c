@@ -0,0 +1,451 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+/*
+ * coop-sim: trace-driven scheduler simulator.
+ *
+ * Recorded workload trace is replayed through the library scheduler with
+ * a virtual clock (the clock is advanced by the simulated run bursts and the
+ * system idle periods), therefore the simulation is deterministic and takes
+ * no real time.
+ *
+ * Usage: coop-sim [-p policy]... trace_file
+ *
+ * Policies:
+ *   rtc       - run bursts are run to completion (default).
+ *   slice:Q   - run bursts are sliced by Q ticks quantum; a thread yields
+ *               after each quantum (as coop_yield_after() does).
+ *
+ * Trace file format (one operation per line, '#' starts a comment):
+ *
+ *   thread NAME [REPEAT]   - start thread definition; the thread operations
+ *                            are replayed REPEAT times (default: 1)
+ *   run TICKS              - run burst
+ *   idle TICKS             - idle period
+ *   wait SEM TIMEOUT       - wait for notification on SEM (0 timeout: wait
+ *                            infinitely)
+ *   notify SEM             - notify single thread waiting on SEM
+ *   notify_all SEM         - notify all threads waiting on SEM
+ *   yield                  - yield to the scheduler
+ *   end                    - finish thread definition
+ *
+ * Latency is measured from an event making a thread ready to run (notify,
+ * timeout or idle period expiration) up to the thread resumption.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "coop_threads.h"
+
+#define MAX_SEM 256
+
+typedef enum
+{
+    OP_RUN = 0,
+    OP_IDLE,
+    OP_WAIT,
+    OP_NOTIFY,
+    OP_NOTIFY_ALL,
+    OP_YIELD
+} op_type_t;
+
+typedef struct
+{
+    op_type_t type;
+    unsigned long arg1;
+    unsigned long arg2;
+} op_t;
+
+/* latency samples */
+typedef struct
+{
+    unsigned long *smpl;
+    size_t n, sz;
+} lat_t;
+
+/* wake-up types */
+typedef enum
+{
+    WK_NOTIFY = 0,
+    WK_TIMEOUT,
+    WK_IDLE,
+    WK_MAX
+} wake_t;
+
+static const char *wake_names[WK_MAX] = { "notify", "timeout", "idle" };
+
+typedef struct
+{
+    char name[32];
+    unsigned long repeat;
+    op_t *ops;
+    size_t ops_n;
+
+    /* clock tick the thread has been notified at */
+    coop_tick_t notif_tick;
+
+    /* simulation results */
+    unsigned long ops_done;
+    unsigned long run_ticks;
+    unsigned long wakes[WK_MAX];
+    lat_t lat;
+} sim_thrd_t;
+
+static sim_thrd_t thrds[CONFIG_MAX_THREADS];
+static unsigned thrds_n = 0;
+static unsigned max_sem = 0;
+
+/* simulation state */
+static struct
+{
+    unsigned long quantum;
+    coop_tick_t clock;
+    unsigned long idle_cb_n;
+    unsigned long stalled;
+    int stop;
+    lat_t lat[WK_MAX];
+} sim;
+
+static void fail(const char *format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    exit(1);
+}
+
+coop_tick_t coop_tick_cb()
+{
+    return sim.clock;
+}
+
+void coop_idle_cb(coop_tick_t period)
+{
+    unsigned i;
+
+    sim.idle_cb_n++;
+    if (period) {
+        sim.clock += period;
+        return;
+    }
+
+    /*
+     * All threads wait infinitely (notifications were lost). The simulation
+     * is stopped by waking up all the stalled threads.
+     */
+    sim.stop = 1;
+    for (i = 0; i <= max_sem; i++) coop_notify_all((int)i);
+}
+
+static void lat_add(lat_t *lat, unsigned long val)
+{
+    if (lat->n >= lat->sz) {
+        lat->sz = (lat->sz ? 2 * lat->sz : 64);
+        if (!(lat->smpl = realloc(lat->smpl, lat->sz * sizeof(*lat->smpl)))) {
+            fail("Out of memory\n");
+        }
+    }
+    lat->smpl[lat->n++] = val;
+}
+
+static int cmp_ul(const void *a, const void *b)
+{
+    unsigned long ua = *(const unsigned long*)a, ub = *(const unsigned long*)b;
+    return (ua < ub ? -1 : (ua > ub));
+}
+
+static unsigned long lat_pct(const lat_t *lat, unsigned pct)
+{
+    size_t i;
+
+    if (!lat->n) return 0;
+    i = (lat->n * pct + 99) / 100;
+    return lat->smpl[i ? i - 1 : 0];
+}
+
+static void wake(sim_thrd_t *thrd, wake_t type, coop_tick_t ready)
+{
+    unsigned long val = (unsigned long)(sim.clock - ready);
+
+    thrd->wakes[type]++;
+    lat_add(&thrd->lat, val);
+    lat_add(&sim.lat[type], val);
+}
+
+/*
+ * Waiting predicate; called for the thread being notified.
+ */
+static bool notified(void *cv)
+{
+    ((sim_thrd_t*)cv)->notif_tick = sim.clock;
+    return true;
+}
+
+static void sim_thread(void *arg)
+{
+    sim_thrd_t *thrd = (sim_thrd_t*)arg;
+    unsigned long r, step;
+    coop_tick_t start;
+    size_t i;
+
+    for (r = 0; r < thrd->repeat && !sim.stop; r++)
+    {
+        for (i = 0; i < thrd->ops_n && !sim.stop; i++)
+        {
+            const op_t *op = &thrd->ops[i];
+
+            switch (op->type)
+            {
+            case OP_RUN:
+                for (step = op->arg1; step; )
+                {
+                    unsigned long s = step;
+                    if (sim.quantum && s > sim.quantum) s = sim.quantum;
+
+                    sim.clock += s;
+                    thrd->run_ticks += s;
+                    step -= s;
+
+                    if (step) coop_yield();
+                }
+                break;
+
+            case OP_IDLE:
+                start = sim.clock;
+                coop_idle(op->arg1);
+                wake(thrd, WK_IDLE, start + op->arg1);
+                break;
+
+            case OP_WAIT:
+                start = sim.clock;
+                if (coop_wait_cond(
+                    (int)op->arg1, op->arg2, notified, thrd) == COOP_SUCCESS)
+                {
+                    if (sim.stop) break;
+                    wake(thrd, WK_NOTIFY, thrd->notif_tick);
+                } else {
+                    wake(thrd, WK_TIMEOUT, start + op->arg2);
+                }
+                break;
+
+            case OP_NOTIFY:
+                coop_notify((int)op->arg1);
+                break;
+
+            case OP_NOTIFY_ALL:
+                coop_notify_all((int)op->arg1);
+                break;
+
+            case OP_YIELD:
+                coop_yield();
+                break;
+            }
+            if (!sim.stop) thrd->ops_done++;
+        }
+    }
+    if (sim.stop) sim.stalled++;
+}
+
+static void load_trace(const char *file)
+{
+    char line[256], cmd[32];
+    sim_thrd_t *thrd = NULL;
+    unsigned long a1, a2;
+    unsigned ln = 0;
+    FILE *f;
+
+    if (!(f = fopen(file, "r"))) {
+        fail("Can't open %s\n", file);
+    }
+
+    while (fgets(line, sizeof(line), f))
+    {
+        char *c = strchr(line, '#');
+        int n;
+        op_t op;
+
+        ln++;
+        if (c) *c = 0;
+
+        a1 = a2 = 0;
+        if ((n = sscanf(line, "%31s %lu %lu", cmd, &a1, &a2)) <= 0) continue;
+
+        if (!strcmp(cmd, "thread")) {
+            if (thrd) fail("%s:%u: missing end\n", file, ln);
+            if (thrds_n >= CONFIG_MAX_THREADS) {
+                fail("%s:%u: too many threads\n", file, ln);
+            }
+            thrd = &thrds[thrds_n++];
+            if (sscanf(line, "%*s %31s %lu", thrd->name, &thrd->repeat) < 2) {
+                thrd->repeat = 1;
+            }
+            continue;
+        } else
+        if (!thrd) {
+            fail("%s:%u: operation outside thread definition\n", file, ln);
+        } else
+        if (!strcmp(cmd, "end")) {
+            thrd = NULL;
+            continue;
+        }
+
+        if (!strcmp(cmd, "run")) {
+            op.type = OP_RUN;
+        } else if (!strcmp(cmd, "idle")) {
+            op.type = OP_IDLE;
+        } else if (!strcmp(cmd, "wait")) {
+            op.type = OP_WAIT;
+        } else if (!strcmp(cmd, "notify")) {
+            op.type = OP_NOTIFY;
+        } else if (!strcmp(cmd, "notify_all")) {
+            op.type = OP_NOTIFY_ALL;
+        } else if (!strcmp(cmd, "yield")) {
+            op.type = OP_YIELD;
+        } else {
+            fail("%s:%u: unknown operation %s\n", file, ln, cmd);
+        }
+
+        if (op.type == OP_WAIT || op.type == OP_NOTIFY ||
+            op.type == OP_NOTIFY_ALL)
+        {
+            if (n < 2 || a1 >= MAX_SEM) {
+                fail("%s:%u: invalid semaphore id\n", file, ln);
+            }
+            if (a1 > max_sem) max_sem = (unsigned)a1;
+        }
+        op.arg1 = a1;
+        op.arg2 = a2;
+
+        thrd->ops = realloc(thrd->ops, (thrd->ops_n + 1) * sizeof(op_t));
+        if (!thrd->ops) fail("Out of memory\n");
+        thrd->ops[thrd->ops_n++] = op;
+    }
+    if (thrd) fail("%s: missing end\n", file);
+
+    fclose(f);
+}
+
+static void simulate(const char *policy)
+{
+    unsigned long run = 0, ops = 0;
+    unsigned i, w;
+    lat_t all = {0};
+
+    if (!strcmp(policy, "rtc")) {
+        sim.quantum = 0;
+    } else
+    if (!strncmp(policy, "slice:", 6) && atol(policy + 6) > 0) {
+        sim.quantum = (unsigned long)atol(policy + 6);
+    } else {
+        fail("Unknown policy %s\n", policy);
+    }
+
+    sim.clock = 0;
+    sim.idle_cb_n = sim.stalled = 0;
+    sim.stop = 0;
+    for (w = 0; w < WK_MAX; w++) sim.lat[w].n = 0;
+
+    for (i = 0; i < thrds_n; i++) {
+        thrds[i].ops_done = thrds[i].run_ticks = 0;
+        memset(thrds[i].wakes, 0, sizeof(thrds[i].wakes));
+        thrds[i].lat.n = 0;
+
+        if (coop_sched_thread(sim_thread, thrds[i].name, 0, &thrds[i]) !=
+            COOP_SUCCESS)
+        {
+            fail("Can't schedule thread %s\n", thrds[i].name);
+        }
+    }
+
+    coop_sched_service();
+
+    printf("policy: %s\n", policy);
+    for (i = 0; i < thrds_n; i++) {
+        run += thrds[i].run_ticks;
+        ops += thrds[i].ops_done;
+    }
+    printf("  virtual time: %lu ticks, busy: %lu ticks (%.1f%%), "
+        "system idle calls: %lu\n", (unsigned long)sim.clock, run,
+        (sim.clock ? 100.0 * run / sim.clock : 0.0), sim.idle_cb_n);
+    printf("  throughput: %.2f ops per 1000 ticks (%lu ops)\n",
+        (sim.clock ? 1000.0 * ops / sim.clock : 0.0), ops);
+    if (sim.stalled) {
+        printf("  stalled threads (lost notifications): %lu\n", sim.stalled);
+    }
+
+    printf("  %-12s %8s %8s %8s %8s %8s\n",
+        "wake-ups", "count", "p50", "p90", "p99", "max");
+    for (w = 0; w < WK_MAX; w++) {
+        lat_t *lat = &sim.lat[w];
+        size_t j;
+
+        qsort(lat->smpl, lat->n, sizeof(*lat->smpl), cmp_ul);
+        printf("  %-12s %8lu %8lu %8lu %8lu %8lu\n", wake_names[w],
+            (unsigned long)lat->n, lat_pct(lat, 50), lat_pct(lat, 90),
+            lat_pct(lat, 99), lat_pct(lat, 100));
+
+        for (j = 0; j < lat->n; j++) lat_add(&all, lat->smpl[j]);
+    }
+    qsort(all.smpl, all.n, sizeof(*all.smpl), cmp_ul);
+    printf("  %-12s %8lu %8lu %8lu %8lu %8lu\n", "all",
+        (unsigned long)all.n, lat_pct(&all, 50), lat_pct(&all, 90),
+        lat_pct(&all, 99), lat_pct(&all, 100));
+    free(all.smpl);
+
+    printf("  %-16s %8s %8s %8s %8s %8s %8s %8s\n", "thread", "ops", "run",
+        "notify", "timeout", "idle", "p50", "p99");
+    for (i = 0; i < thrds_n; i++) {
+        sim_thrd_t *thrd = &thrds[i];
+
+        qsort(thrd->lat.smpl, thrd->lat.n, sizeof(*thrd->lat.smpl), cmp_ul);
+        printf("  %-16s %8lu %8lu %8lu %8lu %8lu %8lu %8lu\n", thrd->name,
+            thrd->ops_done, thrd->run_ticks, thrd->wakes[WK_NOTIFY],
+            thrd->wakes[WK_TIMEOUT], thrd->wakes[WK_IDLE],
+            lat_pct(&thrd->lat, 50), lat_pct(&thrd->lat, 99));
+    }
+    printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+    const char *policies[16];
+    unsigned pols_n = 0, i;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:h")) != -1)
+    {
+        if (opt == 'p' && pols_n < sizeof(policies)/sizeof(policies[0])) {
+            policies[pols_n++] = optarg;
+        } else {
+            fprintf(stderr, "Usage: %s [-p policy]... trace_file\n", argv[0]);
+            return (opt == 'h' ? 0 : 1);
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "Usage: %s [-p policy]... trace_file\n", argv[0]);
+        return 1;
+    }
+    if (!pols_n) policies[pols_n++] = "rtc";
+
+    load_trace(argv[optind]);
+    if (!thrds_n) fail("No threads defined\n");
+
+    for (i = 0; i < pols_n; i++) {
+        simulate(policies[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,25 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+/*
+ * Library configuration the simulator is built with.
+ */
+
+#define CONFIG_DEFAULT_STACK_SIZE 0x1000U
+#define CONFIG_MAX_THREADS 32
+
+#define CONFIG_OPT_IDLE
+#define CONFIG_OPT_WAIT
+
+/* virtual clock */
+#define CONFIG_TICK_CB_ALT
+#define CONFIG_IDLE_CB_ALT
@@ -10,52 +10,154 @@
  * See the License for more information.
  */
 
+/*
+ * Threads churn stress test.
+ *
+ * Threads perform random operations (spawn, idle, wait, notify, exit) on
+ * a virtual clock. Scheduler invariants are checked after each operation.
+ *
+ * Usage: st01_enter_exit [-n operations] [-s seed]
+ *
+ * 0 operations: run forever.
+ */
+
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
 #include "coop_threads.h"
 
-static unsigned thrd_cnt = 0;
+#define SEMS 4
 
-static void thrd_proc(void *arg)
+static coop_tick_t vclock = 0;
+
+static unsigned long ops_max = 1000000;
+static unsigned long ops = 0;
+static unsigned long spawns = 0;
+static unsigned peak_holes = 0;
+
+coop_tick_t coop_tick_cb()
 {
-    int next_step;
-    unsigned cnt = 0, thrd_id = (unsigned)(size_t)arg;
+    return vclock;
+}
 
-    printf("thrd_%u: ENTER\n", thrd_id);
+void coop_idle_cb(coop_tick_t period)
+{
+    vclock += period;
+}
 
-    for (;;)
-    {
-        printf("thrd_%u: %u\n", thrd_id, ++cnt);
-        coop_idle(100);
+static bool next_op(void)
+{
+    unsigned holes;
 
-        next_step = rand() % 10;
+    ops++;
+    vclock++;
 
-        if ((next_step >=0 && next_step <=5)) {
-            /*
-             * Probability 0.6: terminate current thread if it's most shallow
-             */
-            if (coop_test_is_shallow()) break;
-        } else {
+    /* checked regardless of NDEBUG */
+    if (!coop_test_check_invariants()) {
+        fprintf(stderr, "Scheduler invariants violated at operation %lu\n",
+            ops);
+        abort();
+    }
+
+    holes = coop_test_get_hole_n();
+    if (holes > peak_holes) peak_holes = holes;
+
+    return (!ops_max || ops < ops_max);
+}
+
+static void thrd_proc(void *arg)
+{
+    (void)arg;
+
+    while (next_op())
+    {
+        switch (rand() % 10)
+        {
+        case 0:
+        case 1:
+        case 2:
             /*
-             * Probability 0.4: schedule new thread to run. May fail with limit
-             * error in case no space is available on the threads pool (e.g.
-             * terminating threads end as holes still occupying the main stack
-             * and the pool).
+             * Schedule new thread to run. May fail with limit error in case
+             * no space is available on the threads pool (e.g. terminating
+             * threads end as holes still occupying the main stack and
+             * the pool).
              */
-            coop_sched_thread(thrd_proc, NULL, 0, (void*)(size_t)(++thrd_cnt));
+            if (coop_sched_thread(thrd_proc, NULL, 0, NULL) == COOP_SUCCESS)
+                spawns++;
+            coop_yield();
+            break;
+
+        case 3:
+        case 4:
+            coop_idle(1 + rand() % 20);
+            break;
+
+        case 5:
+        case 6:
+            coop_wait(rand() % SEMS, 1 + rand() % 50);
+            break;
+
+        case 7:
+            coop_notify(rand() % SEMS);
+            coop_yield();
+            break;
+
+        case 8:
+            coop_notify_all(rand() % SEMS);
+            coop_yield();
+            break;
+
+        default:
+            /* terminate the thread; possibly leaving a hole */
+            return;
         }
     }
-
-    printf("thrd_%u: EXIT\n", thrd_id);
 }
 
 int main(int argc, char *argv[])
 {
-    for (int i = 0; i < CONFIG_MAX_THREADS; i++) {
-        coop_sched_thread(thrd_proc, NULL, 0, (void*)(size_t)(++thrd_cnt));
+    unsigned seed = 1;
+    struct timespec start, end;
+    double secs;
+    int opt, i;
+
+    while ((opt = getopt(argc, argv, "n:s:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            ops_max = (unsigned long)strtod(optarg, NULL);
+            break;
+        case 's':
+            seed = (unsigned)strtoul(optarg, NULL, 0);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-n operations] [-s seed]\n", argv[0]);
+            return 1;
+        }
+    }
+    srand(seed);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    /* re-populate the pool as long as all threads terminated */
+    while (!ops_max || ops < ops_max)
+    {
+        for (i = 0; i < CONFIG_MAX_THREADS / 2; i++) {
+            if (coop_sched_thread(thrd_proc, NULL, 0, NULL) == COOP_SUCCESS)
+                spawns++;
+        }
+        coop_sched_service();
     }
-    coop_sched_service();
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    printf("seed: %u, operations: %lu, spawns: %lu, virtual ticks: %lu\n",
+        seed, ops, spawns, (unsigned long)vclock);
+    printf("peak holes: %u, operations/s: %.0f\n", peak_holes, ops / secs);
 
     return 0;
 }
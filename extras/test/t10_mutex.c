@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include "coop_threads.h"
+
+static coop_mutex_t mtx = COOP_MUTEX_INIT;
+
+static void thrd_proc(void *arg)
+{
+    for (int i = 0; i < 2; i++) {
+        assert(coop_mutex_lock(&mtx, 0) == COOP_SUCCESS);
+        assert(coop_mutex_lock(&mtx, 0) == COOP_ERR_INV_ARG);
+
+        printf("%s: locked\n", coop_thread_name());
+        coop_idle(50);
+        printf("%s: unlocking\n", coop_thread_name());
+
+        /* the mutex is passed to the first waiting thread; re-locking
+           immediately after unlocking must queue behind waiting threads */
+        assert(coop_mutex_unlock(&mtx) == COOP_SUCCESS);
+    }
+    printf("%s EXIT\n", coop_thread_name());
+}
+
+static void thrd_tmo(void *arg)
+{
+    coop_tick_t start = coop_tick_cb();
+
+    assert(!coop_mutex_trylock(&mtx));
+    assert(coop_mutex_unlock(&mtx) == COOP_ERR_INV_ARG);
+
+    if (coop_mutex_lock(&mtx, 20) == COOP_ERR_TIMEOUT) {
+        printf("%s: time-out; %lu ticks passed\n", coop_thread_name(),
+            (unsigned long)(coop_tick_cb() - start) / 10 * 10);
+    }
+    printf("%s EXIT\n", coop_thread_name());
+}
+
+int main(int argc, char *argv[])
+{
+    coop_sched_thread(thrd_proc, "thrd_1", 0, NULL);
+    coop_sched_thread(thrd_proc, "thrd_2", 0, NULL);
+    coop_sched_thread(thrd_proc, "thrd_3", 0, NULL);
+    coop_sched_thread(thrd_tmo, "thrd_tmo", 0, NULL);
+    coop_sched_service();
+
+    assert(!mtx.owner && !mtx.wq.head && !mtx.wq.tail);
+    return 0;
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include "coop_threads.h"
+
+/* waiting addresses; all of them hashed into the same bucket */
+static int addr_1 = 0;
+static int addr_2 = 0;
+static int addr_3 = 0;
+
+static void thrd_proc(void *arg)
+{
+    int *addr = (int*)arg;
+    coop_tick_t start = coop_tick_cb();
+
+    while (*addr == 0) {
+        if (coop_wait_addr(addr, 0, 250) != COOP_SUCCESS) {
+            printf("%s: time-out; %lu ticks passed\n", coop_thread_name(),
+                (unsigned long)(coop_tick_cb() - start) / 10 * 10);
+            break;
+        }
+    }
+    printf("%s EXIT\n", coop_thread_name());
+}
+
+static void thrd_wake(void *arg)
+{
+    /* value not as expected; no waiting */
+    assert(coop_wait_addr(&addr_1, 1, 0) == COOP_SUCCESS);
+
+    coop_idle(100);
+    assert(coop_wake_addr(&addr_3, 0) == 0);
+
+    /* spurious wake-up; threads will get back to the waiting state */
+    assert(coop_wake_addr(&addr_1, 0) == 2);
+    coop_idle(100);
+
+    addr_1 = 1;
+    assert(coop_wake_addr(&addr_1, 1) == 1);
+    coop_idle(100);
+    assert(coop_wake_addr(&addr_1, 0) == 1);
+
+    printf("%s EXIT\n", coop_thread_name());
+}
+
+int main(int argc, char *argv[])
+{
+    coop_sched_thread(thrd_proc, "thrd_1", 0, &addr_1);
+    coop_sched_thread(thrd_proc, "thrd_2", 0, &addr_2);
+    coop_sched_thread(thrd_proc, "thrd_3", 0, &addr_1);
+    coop_sched_thread(thrd_wake, "thrd_wake", 0, NULL);
+    coop_sched_service();
+
+    return 0;
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+#include <assert.h>
+#include <signal.h>
+#include <stdio.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "coop_threads.h"
+
+#define DATA_N 10
+
+static coop_ring_t ring;
+static unsigned char ring_buf[4];
+
+/*
+ * SIGALRM handler playing ISR role - the ring producer.
+ */
+static void isr_handler(int sig)
+{
+    static unsigned char data = 0;
+
+    if (data < DATA_N) {
+        coop_ring_put(&ring, data++);
+    }
+}
+
+void coop_idle_cb(coop_tick_t period)
+{
+    /* sleep interrupted by the "ISR" */
+    if (period) {
+        usleep((useconds_t)period * 1000);
+    } else {
+        pause();
+    }
+}
+
+static void thrd_reader(void *arg)
+{
+    unsigned char c;
+
+    for (int i = 0; i < DATA_N; i++) {
+        assert(coop_ring_get(&ring, &c, 0) == COOP_SUCCESS);
+        printf("%s: %d\n", coop_thread_name(), c);
+    }
+    assert(coop_ring_get(&ring, &c, 50) == COOP_ERR_TIMEOUT);
+
+    printf("%s EXIT\n", coop_thread_name());
+}
+
+static void thrd_busy(void *arg)
+{
+    /* keeps the system running for a while; the reader is woken-up via
+       the scheduler loop */
+    coop_tick_t end = coop_tick_cb() + 25;
+    while (coop_tick_cb() < end) {
+        coop_yield();
+    }
+    printf("%s EXIT\n", coop_thread_name());
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned char c = 0;
+    struct itimerval tv = {{0, 10000}, {0, 10000}};
+
+    assert(coop_ring_init(&ring, ring_buf, 3) == COOP_ERR_INV_ARG);
+    assert(coop_ring_init(&ring, ring_buf, sizeof(ring_buf)) == COOP_SUCCESS);
+
+    /* at most size-1 bytes fit the ring */
+    assert(coop_ring_put(&ring, c++));
+    assert(coop_ring_put(&ring, c++));
+    assert(coop_ring_put(&ring, c++));
+    assert(!coop_ring_put(&ring, c));
+    coop_ring_init(&ring, ring_buf, sizeof(ring_buf));
+
+    signal(SIGALRM, isr_handler);
+    setitimer(ITIMER_REAL, &tv, NULL);
+
+    coop_sched_thread(thrd_reader, "thrd_reader", 0, NULL);
+    coop_sched_thread(thrd_busy, "thrd_busy", 0, NULL);
+    coop_sched_service();
+
+    return 0;
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+#include <assert.h>
+#include <poll.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include "coop_threads.h"
+
+static int pipe_fds[2];
+static coop_tick_t start;
+
+#define ELAPSED() ((unsigned long)(coop_tick_cb() - start) / 10 * 10)
+
+static void thrd_sleep(void *arg)
+{
+    /* legacy, blocking sleeps */
+    usleep(100000);
+    printf("%s: usleep; %lu ticks passed\n", coop_thread_name(), ELAPSED());
+
+    nanosleep(&(struct timespec){0, 100000000}, NULL);
+    printf("%s: nanosleep; %lu ticks passed\n", coop_thread_name(), ELAPSED());
+
+    printf("%s EXIT\n", coop_thread_name());
+}
+
+static void thrd_read(void *arg)
+{
+    char c;
+    struct pollfd pfd = {pipe_fds[0], POLLIN, 0};
+
+    /* time-out while nothing to read */
+    assert(poll(&pfd, 1, 50) == 0);
+    printf("%s: poll time-out; %lu ticks passed\n",
+        coop_thread_name(), ELAPSED());
+
+    /* legacy, blocking read */
+    assert(read(pipe_fds[0], &c, 1) == 1);
+    printf("%s: read '%c'; %lu ticks passed\n",
+        coop_thread_name(), c, ELAPSED());
+
+    printf("%s EXIT\n", coop_thread_name());
+}
+
+static void thrd_write(void *arg)
+{
+    usleep(150000);
+    assert(write(pipe_fds[1], "X", 1) == 1);
+
+    printf("%s EXIT\n", coop_thread_name());
+}
+
+int main(int argc, char *argv[])
+{
+    assert(!pipe(pipe_fds));
+
+    start = coop_tick_cb();
+    coop_sched_thread(thrd_sleep, "thrd_sleep", 0, NULL);
+    coop_sched_thread(thrd_read, "thrd_read", 0, NULL);
+    coop_sched_thread(thrd_write, "thrd_write", 0, NULL);
+    coop_sched_service();
+
+    return 0;
+}
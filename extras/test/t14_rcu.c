@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "coop_threads.h"
+
+/* RCU protected data */
+typedef struct {
+    int version;
+    coop_rcu_head_t rcu;
+} data_t;
+
+static data_t *data = NULL;
+
+static void free_data(coop_rcu_head_t *head)
+{
+    data_t *old = (data_t*)((char*)head - offsetof(data_t, rcu));
+
+    printf("version %d freed\n", old->version);
+    free(old);
+}
+
+static void update(int version, bool sync)
+{
+    data_t *old = data;
+
+    data = malloc(sizeof(*data));
+    assert(data);
+    data->version = version;
+
+    if (old) {
+        if (sync) {
+            coop_synchronize_rcu();
+            printf("%s: grace period elapsed\n", coop_thread_name());
+            free_data(&old->rcu);
+        } else {
+            coop_call_rcu(&old->rcu, free_data);
+        }
+    }
+}
+
+static void thrd_reader(void *arg)
+{
+    for (int i = 0; i < 3; i++) {
+        coop_rcu_read_lock();
+        printf("%s: version %d\n", coop_thread_name(), data->version);
+        coop_rcu_read_unlock();
+
+        coop_yield();
+    }
+    printf("%s EXIT\n", coop_thread_name());
+}
+
+static void thrd_updater(void *arg)
+{
+    update(2, false);
+    coop_yield();
+    update(3, true);
+
+    printf("%s EXIT\n", coop_thread_name());
+}
+
+int main(int argc, char *argv[])
+{
+    data = malloc(sizeof(*data));
+    assert(data);
+    data->version = 1;
+
+    coop_sched_thread(thrd_reader, "thrd_reader", 0, NULL);
+    coop_sched_thread(thrd_updater, "thrd_updater", 0, NULL);
+    coop_sched_service();
+
+    free(data);
+    return 0;
+}
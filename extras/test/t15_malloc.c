@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include "coop_threads.h"
+
+static void thrd_proc(void *arg)
+{
+    void *p[4];
+
+    for (int i = 0; i < 4; i++) {
+        p[i] = coop_malloc((size_t)arg);
+        assert(p[i] && !((size_t)p[i] & (sizeof(long long) - 1)));
+        memset(p[i], 0, (size_t)arg);
+        coop_yield();
+    }
+
+    /* freed blocks are reused in LIFO order */
+    coop_free(p[1]);
+    coop_free(p[3]);
+    assert(coop_malloc((size_t)arg) == p[3]);
+    assert(coop_malloc((size_t)arg) == p[1]);
+
+    for (int i = 0; i < 4; i++) {
+        coop_free(p[i]);
+    }
+    printf("%s EXIT\n", coop_thread_name());
+}
+
+int main(int argc, char *argv[])
+{
+    void *p;
+    unsigned n;
+
+    coop_free(NULL);
+
+    /* larger than the largest class */
+    assert(!coop_malloc(65));
+
+    coop_sched_thread(thrd_proc, "thrd_1", 0, (void*)(size_t)1);
+    coop_sched_thread(thrd_proc, "thrd_2", 0, (void*)(size_t)20);
+    coop_sched_thread(thrd_proc, "thrd_3", 0, (void*)(size_t)64);
+    coop_sched_service();
+
+    /* freed blocks are kept on their classes; exhaust the arena */
+    for (n = 0; (p = coop_malloc(16)) != NULL; n++);
+    printf("%u blocks of 16 bytes allocated\n", n);
+
+    /* 8 bytes class free-list still contains blocks */
+    assert(coop_malloc(8));
+
+    return 0;
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include "coop_threads.h"
+
+static void *shared = NULL;
+static void *orphan = NULL;
+
+void coop_mem_limit_cb(const char *name, size_t size)
+{
+    printf("coop_mem_limit_cb(%s, %lu) called-back\n",
+        name, (unsigned long)size);
+}
+
+static void print_stats(unsigned thrd)
+{
+    coop_thrd_stats_t stats;
+
+    assert(coop_thread_stats(thrd, &stats) == COOP_SUCCESS);
+    printf("%s: cur: %lu, peak: %lu, total: %lu\n", stats.name,
+        (unsigned long)stats.mem_cur, (unsigned long)stats.mem_peak,
+        (unsigned long)stats.mem_total);
+}
+
+static void thrd_alloc(void *arg)
+{
+    void *p1, *p2;
+
+    coop_thread_mem_limit(100);
+
+    p1 = coop_malloc(30);
+    p2 = coop_malloc(60);
+    assert(p1 && p2);
+    assert(!coop_malloc(20));
+
+    coop_free(p1);
+    print_stats(COOP_CUR_THRD);
+
+    /* block freed by other thread */
+    shared = p2;
+    coop_yield();
+
+    print_stats(COOP_CUR_THRD);
+    printf("%s EXIT\n", coop_thread_name());
+}
+
+static void thrd_free(void *arg)
+{
+    while (!shared) coop_yield();
+    coop_free(shared);
+
+    print_stats(COOP_CUR_THRD);
+    printf("%s EXIT\n", coop_thread_name());
+}
+
+/* terminates leaving its memory allocated */
+static void thrd_orphan(void *arg)
+{
+    orphan = coop_malloc(50);
+    assert(orphan);
+
+    print_stats(COOP_CUR_THRD);
+    printf("%s EXIT\n", coop_thread_name());
+}
+
+/* reuses the pool slot of the terminated orphan thread */
+static void thrd_reuse(void *arg)
+{
+    void *p = coop_malloc(40);
+    assert(p);
+
+    /* not credited to the current slot occupant */
+    coop_free(orphan);
+    print_stats(COOP_CUR_THRD);
+
+    coop_free(p);
+    print_stats(COOP_CUR_THRD);
+    printf("%s EXIT\n", coop_thread_name());
+}
+
+int main(int argc, char *argv[])
+{
+    coop_thrd_stats_t stats;
+
+    /* not accounted */
+    assert(coop_malloc(10));
+
+    coop_sched_thread(thrd_alloc, "thrd_alloc", 0, NULL);
+    coop_sched_thread(thrd_free, "thrd_free", 0, NULL);
+
+    assert(coop_thread_stats(CONFIG_MAX_THREADS, &stats) == COOP_ERR_INV_ARG);
+    assert(coop_thread_stats(2, &stats) == COOP_ERR_INV_ARG);
+    print_stats(0);
+
+    coop_sched_service();
+
+    coop_sched_thread(thrd_orphan, "thrd_orphan", 0, NULL);
+    coop_sched_service();
+
+    coop_sched_thread(thrd_reuse, "thrd_reuse", 0, NULL);
+    coop_sched_service();
+
+    return 0;
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "coop_threads.h"
+#include "coop_stats.h"
+
+#define SHM_NAME "/coop_t17"
+#define SEM_ID 5
+#define RUN_TIME 20
+
+static const coop_stats_exp_t *exp = NULL;
+
+static void thrd_wait(void *arg)
+{
+    coop_tick_t start = coop_tick_cb();
+
+    /* busy run */
+    while (!COOP_IS_TICK_OVER(coop_tick_cb(), start + RUN_TIME));
+
+    assert(coop_wait(SEM_ID, 0) == COOP_SUCCESS);
+    printf("%s notified\n", coop_thread_name());
+
+    coop_idle(10);
+    printf("%s EXIT\n", coop_thread_name());
+}
+
+static void thrd_check(void *arg)
+{
+    coop_thrd_stats_t stats;
+
+    coop_yield();
+
+    assert(coop_thread_stats(0, &stats) == COOP_SUCCESS);
+    printf("%s: %s, switches: %lu, sem: %d, obj: %p\n", stats.name,
+        stats.state, stats.switch_n, stats.wait_sem, stats.wait_obj);
+    assert(stats.run_ticks >= RUN_TIME);
+
+    /* exported at the thread switch */
+    assert(exp->thrds[0].state == COOP_STATS_WAIT);
+    /* name exported at the spawn is kept */
+    assert(!strcmp(exp->thrds[0].name, "thrd_wait"));
+    assert(exp->thrds[0].wait_sem == SEM_ID);
+    assert(exp->thrds[0].run_ticks == (uint32_t)stats.run_ticks);
+
+    coop_notify(SEM_ID);
+    coop_yield();
+
+    assert(coop_thread_stats(0, &stats) == COOP_SUCCESS);
+    printf("%s: %s, switches: %lu\n", stats.name, stats.state,
+        stats.switch_n);
+    assert(stats.stack_wm > 0);
+
+    assert(coop_thread_stats(COOP_CUR_THRD, &stats) == COOP_SUCCESS);
+    printf("%s: %s, switches: %lu\n", stats.name, stats.state,
+        stats.switch_n);
+
+    printf("%s EXIT\n", coop_thread_name());
+}
+
+int main(int argc, char *argv[])
+{
+    coop_sched_stats_t sched_stats;
+    int fd;
+
+    assert(coop_stats_shm_export(SHM_NAME) == COOP_SUCCESS);
+
+    /* attach as an external viewer would do */
+    assert((fd = shm_open(SHM_NAME, O_RDONLY, 0)) >= 0);
+    exp = mmap(NULL, COOP_STATS_EXP_SIZE(CONFIG_MAX_THREADS),
+        PROT_READ, MAP_SHARED, fd, 0);
+    assert(exp != MAP_FAILED);
+    close(fd);
+
+    assert(exp->magic == COOP_STATS_MAGIC);
+    assert(exp->thrds_n == CONFIG_MAX_THREADS);
+
+    coop_sched_thread(thrd_wait, "thrd_wait", 0, NULL);
+    coop_sched_thread(thrd_check, "thrd_check", 0, NULL);
+
+    assert(!(exp->seq & 1));
+    assert(exp->busy_n == 2);
+    assert(!strcmp(exp->thrds[0].name, "thrd_wait"));
+    assert(exp->thrds[0].state == COOP_STATS_NEW);
+    assert(exp->thrds[2].state == COOP_STATS_EMPTY);
+
+    coop_sched_service();
+
+    /* final export after all threads terminated */
+    assert(exp->busy_n == 0);
+    assert(exp->thrds[0].state == COOP_STATS_EMPTY);
+
+    coop_sched_stats(&sched_stats);
+    assert(!sched_stats.switch_n && !sched_stats.busy_n);
+
+    coop_stats_export(NULL);
+    shm_unlink(SHM_NAME);
+
+    return 0;
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include "coop_threads.h"
+
+#define HOLD_TIME 100
+#define WAIT_TIME 50
+
+static coop_mutex_t mtx = COOP_MUTEX_INIT;
+static int addr = 0;
+
+static void thrd_lock(void *arg)
+{
+    assert(coop_mutex_lock(&mtx, 0) == COOP_SUCCESS);
+    coop_idle(HOLD_TIME);
+    assert(coop_mutex_unlock(&mtx) == COOP_SUCCESS);
+
+    printf("%s EXIT\n", coop_thread_name());
+}
+
+static void thrd_cont(void *arg)
+{
+    coop_yield();
+
+    /* contended lock */
+    assert(coop_mutex_lock(&mtx, 0) == COOP_SUCCESS);
+    assert(coop_mutex_unlock(&mtx) == COOP_SUCCESS);
+
+    printf("%s EXIT\n", coop_thread_name());
+}
+
+static void thrd_sem(void *arg)
+{
+    assert(coop_wait(1, WAIT_TIME) == COOP_ERR_TIMEOUT);
+
+    /* no waiter */
+    coop_notify(2);
+
+    printf("%s EXIT\n", coop_thread_name());
+}
+
+int main(int argc, char *argv[])
+{
+    coop_prof_stats_t report[CONFIG_PROF_ENTRIES];
+    unsigned i, n;
+
+    coop_sched_thread(thrd_lock, "thrd_lock", 0, NULL);
+    coop_sched_thread(thrd_cont, "thrd_cont", 0, NULL);
+    coop_sched_thread(thrd_sem, "thrd_sem", 0, NULL);
+
+    coop_sched_service();
+
+    /* profiler table is full; not accounted */
+    assert(!coop_wake_addr(&addr, 0));
+
+    n = coop_prof_report(report, CONFIG_PROF_ENTRIES);
+    assert(n == CONFIG_PROF_ENTRIES);
+
+    for (i = 0; i < n; i++) {
+        if (report[i].obj == &mtx) {
+            printf("mutex");
+            assert(report[i].max >= HOLD_TIME - 1);
+        } else {
+            assert(!report[i].obj);
+            printf("sem_id %d", report[i].sem_id);
+            if (report[i].waits) assert(report[i].max >= WAIT_TIME);
+        }
+        printf(": waits: %lu, timeouts: %lu, lost: %lu\n", report[i].waits,
+            report[i].timeouts, report[i].lost);
+        assert(report[i].total == report[i].max);
+    }
+
+    /* top entry only */
+    assert(coop_prof_report(report, 1) == 1);
+    assert(report[0].obj == &mtx);
+
+    coop_prof_reset();
+    assert(!coop_prof_report(report, CONFIG_PROF_ENTRIES));
+
+    return 0;
+}
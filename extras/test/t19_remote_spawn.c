@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include "coop_threads.h"
+
+#define PRODUCERS 4
+#define SPAWNS 25   /* per producer */
+#define SIG_SPAWNS 1 /* spawned by the signal handler */
+#define SEM_DONE 1
+#define MAX_TIME 1000
+
+/* updated by coop threads only */
+static unsigned done = 0;
+static unsigned long sum = 0;
+
+static pthread_t main_thrd;
+
+static void thrd_spawned(void *arg)
+{
+    sum += (unsigned long)arg;
+    done++;
+    coop_notify(SEM_DONE);
+}
+
+/* resident thread keeping the scheduler running */
+static void thrd_resident(void *arg)
+{
+    coop_tick_t start = coop_tick_cb();
+
+    while (done < PRODUCERS * SPAWNS + SIG_SPAWNS) {
+        /* infinite wait; the system goes idle infinitely */
+        coop_wait(SEM_DONE, 0);
+    }
+
+    /* idle state was finished by the spawning producers */
+    assert(!COOP_IS_TICK_OVER(coop_tick_cb(), start + MAX_TIME));
+
+    printf("%s: %u threads spawned remotely, sum: %lu\n",
+        coop_thread_name(), done, sum);
+}
+
+/* the spawn is signal-safe */
+static void sig_handler(int sig)
+{
+    assert(coop_spawn_remote(thrd_spawned, "thrd_sig", 0,
+        (void*)(PRODUCERS * SPAWNS + 1UL)) == COOP_SUCCESS);
+}
+
+static void *producer(void *arg)
+{
+    unsigned long i, base = (unsigned long)arg * SPAWNS;
+
+    for (i = 0; i < SPAWNS; i++)
+    {
+        coop_error_t ret;
+
+        while ((ret = coop_spawn_remote(thrd_spawned, "thrd_spawned", 0,
+            (void*)(base + i + 1))) == COOP_ERR_LIMIT)
+        {
+            /* injection queue full */
+            sched_yield();
+        }
+        assert(ret == COOP_SUCCESS);
+    }
+
+    if (!arg) {
+        /* all spawns run (the injection queue is empty); interrupt
+           the idle scheduler */
+        while (__atomic_load_n(&done, __ATOMIC_ACQUIRE) < PRODUCERS * SPAWNS) {
+            sched_yield();
+        }
+        pthread_kill(main_thrd, SIGUSR1);
+    }
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    pthread_t thrds[PRODUCERS];
+    unsigned long i;
+
+    assert(coop_spawn_remote(NULL, NULL, 0, NULL) == COOP_ERR_INV_ARG);
+
+    main_thrd = pthread_self();
+    signal(SIGUSR1, sig_handler);
+
+    coop_sched_thread(thrd_resident, "thrd_resident", 0, NULL);
+
+    for (i = 0; i < PRODUCERS; i++) {
+        assert(!pthread_create(&thrds[i], NULL, producer, (void*)i));
+    }
+
+    coop_sched_service();
+
+    for (i = 0; i < PRODUCERS; i++) {
+        pthread_join(thrds[i], NULL);
+    }
+    return 0;
+}
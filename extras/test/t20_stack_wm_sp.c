@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include "coop_threads.h"
+
+#define FRAME_SZ 0x40
+#define DEPTH 8
+
+static size_t nested(unsigned n)
+{
+    volatile unsigned char buf[FRAME_SZ];
+
+    buf[0] = (unsigned char)n;
+    if (n) return nested(n - 1) + buf[0];
+
+    /* instrumentation point */
+    coop_stack_sample();
+    return buf[0];
+}
+
+static void thrd_proc(void *arg)
+{
+    size_t wm;
+
+    /* stack not yet allocated */
+    assert(!coop_stack_wm_sp());
+    coop_yield();
+
+    wm = coop_stack_wm_sp();
+    assert(wm < FRAME_SZ);
+
+    nested(DEPTH);
+    assert(coop_stack_wm_sp() >= wm + DEPTH * FRAME_SZ);
+    wm = coop_stack_wm_sp();
+
+    /* not more than the padding scan shows */
+    assert(wm <= coop_stack_wm());
+
+    /* water-mark not lowered by a shallower sample */
+    coop_yield();
+    assert(coop_stack_wm_sp() == wm);
+}
+
+int main(int argc, char *argv[])
+{
+    coop_sched_thread(thrd_proc, "thrd", 0, NULL);
+    coop_sched_service();
+
+    return 0;
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include "coop_threads.h"
+
+#define STACK_SZ 0x1000
+
+void coop_stack_overflow_cb(const char *name)
+{
+    printf("coop_stack_overflow_cb: %s\n", name);
+}
+
+/*
+ * Use @c n bytes of the stack.
+ */
+static void use_stack(size_t n)
+{
+    volatile unsigned char buf[n];
+    memset((unsigned char*)buf, 0, n);
+}
+
+static void thrd_ok(void *arg)
+{
+    coop_yield();
+
+    /* stay within the stack limit */
+    use_stack(STACK_SZ / 2);
+    coop_yield();
+
+    printf("%s: EXIT\n", (const char*)arg);
+}
+
+static void thrd_ovf(void *arg)
+{
+    unsigned *canary, saved;
+    unsigned char *stack;
+
+    coop_yield();
+
+    /* the test assumes stack growing into lower addresses */
+    stack = (unsigned char*)coop_test_get_stack(coop_test_get_cur_thrd());
+    assert(stack < (unsigned char*)&stack);
+
+    /* overwrite the canary (stack overflow simulation) */
+    canary = (unsigned*)stack - 1;
+    saved = *canary;
+    *canary = ~saved;
+
+    printf("%s: stack overflow\n", (const char*)arg);
+    coop_yield();
+
+    *canary = saved;
+    coop_yield();
+
+    printf("%s: EXIT\n", (const char*)arg);
+}
+
+int main(int argc, char *argv[])
+{
+    coop_sched_thread(thrd_ok, "thrd_1", STACK_SZ, "thrd_1");
+    coop_sched_thread(thrd_ovf, "thrd_2", STACK_SZ, "thrd_2");
+    coop_sched_thread(thrd_ok, "thrd_3", STACK_SZ, "thrd_3");
+    coop_sched_service();
+
+    return 0;
+}
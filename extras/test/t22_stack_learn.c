@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include "coop_threads.h"
+
+#define USE_SZ 0x300
+
+static size_t learned = 0;
+
+/*
+ * Use @c n bytes of the stack.
+ */
+static void use_stack(size_t n)
+{
+    volatile unsigned char buf[n];
+    memset((unsigned char*)buf, 0, n);
+}
+
+/*
+ * Threads don't print (stdio stack usage is not constant); the stack sizes
+ * are reported by main().
+ */
+static void thrd_proc(void *arg)
+{
+    *(size_t*)arg = coop_test_get_stack_sz(coop_test_get_cur_thrd());
+
+    coop_yield();
+    use_stack(USE_SZ);
+}
+
+static void report(const char *name, size_t stack_sz)
+{
+    if (stack_sz == CONFIG_DEFAULT_STACK_SIZE) {
+        printf("%s: default stack size\n", name);
+    } else
+    if (learned && stack_sz == learned + CONFIG_STACK_LEARN_MARGIN) {
+        printf("%s: learned stack size\n", name);
+    } else {
+        printf("%s: stack size 0x%lx\n", name, (unsigned long)stack_sz);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    size_t sz1, sz2;
+
+    remove(CONFIG_STACK_LEARN_FILE);
+
+    coop_sched_thread(thrd_proc, "worker", 0, &sz1);
+    coop_sched_thread(thrd_proc, NULL, 0, &sz2);
+    coop_sched_service();
+
+    printf("Run 1\n");
+    report("worker", sz1);
+    report("unnamed", sz2);
+
+    learned = coop_stack_learn_load_cb("worker");
+    assert(learned >= USE_SZ && learned < CONFIG_DEFAULT_STACK_SIZE);
+
+    /* not saved for unnamed threads */
+    assert(!coop_stack_learn_load_cb(""));
+
+    coop_sched_thread(thrd_proc, "worker", 0, &sz1);
+    coop_sched_thread(thrd_proc, "fixed", 0x800, &sz2);
+    coop_sched_service();
+
+    printf("Run 2\n");
+    report("worker", sz1);
+    report("fixed", sz2);
+
+    /* max usage persisted */
+    assert(coop_stack_learn_load_cb("worker") >= learned);
+    assert(coop_stack_learn_load_cb("fixed") >= USE_SZ);
+
+    remove(CONFIG_STACK_LEARN_FILE);
+    return 0;
+}
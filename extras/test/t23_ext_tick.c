@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+#include <stdio.h>
+#include "coop_threads.h"
+
+/* virtual clock started close to its wrap-around */
+static coop_tick_t tick = COOP_MAX_TICK - 4;
+
+static void print_ticks(const char *prefix, coop_period_t ticks)
+{
+    if (ticks >= COOP_MAX_PERIOD) {
+        printf("%sCOOP_MAX_PERIOD + %lu ticks\n",
+            prefix, (unsigned long)(ticks - COOP_MAX_PERIOD));
+    } else {
+        printf("%s%lu ticks\n", prefix, (unsigned long)ticks);
+    }
+}
+
+coop_tick_t coop_tick_cb()
+{
+    return tick;
+}
+
+void coop_idle_cb(coop_tick_t period)
+{
+    print_ticks("coop_idle_cb: ", period);
+    tick += period;
+}
+
+void thrd_idle(void *arg)
+{
+    coop_tick_t start = tick;
+
+    coop_idle(*(coop_period_t*)arg);
+    printf("%s: ", coop_thread_name());
+    print_ticks("was idle for ", tick - start);
+}
+
+void thrd_wait(void *arg)
+{
+    coop_tick_t start = tick;
+
+    if (coop_wait(1, *(coop_period_t*)arg) == COOP_ERR_TIMEOUT) {
+        printf("%s: ", coop_thread_name());
+        print_ticks("waited with timeout for ", tick - start);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    /* periods exceeding COOP_MAX_PERIOD */
+    coop_period_t idle_1 = 10, idle_2 = (coop_period_t)COOP_MAX_PERIOD + 20;
+    coop_period_t wait_3 = (coop_period_t)COOP_MAX_PERIOD + 30;
+
+    coop_sched_thread(thrd_idle, "thrd_1", 0, &idle_1);
+    coop_sched_thread(thrd_idle, "thrd_2", 0, &idle_2);
+    coop_sched_thread(thrd_wait, "thrd_3", 0, &wait_3);
+    coop_sched_service();
+
+    return 0;
+}
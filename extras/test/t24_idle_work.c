@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+#include <stdio.h>
+#include "coop_threads.h"
+
+/* work chunk duration */
+#define CHUNK_TICKS 30
+
+/* virtual clock */
+static coop_tick_t tick = 0;
+
+coop_tick_t coop_tick_cb()
+{
+    return tick;
+}
+
+void coop_idle_cb(coop_tick_t period)
+{
+    printf("coop_idle_cb(%lu) called-back\n", (unsigned long)period);
+    tick += period;
+}
+
+bool idle_work(coop_tick_t remain, void *arg)
+{
+    int *chunks = (int*)arg;
+
+    if (!*chunks) {
+        /* nothing to do */
+        return false;
+    }
+
+    printf("idle_work: chunk %d; %lu ticks remain\n",
+        *chunks, (unsigned long)remain);
+    (*chunks)--;
+
+    tick += (remain < CHUNK_TICKS ? remain : CHUNK_TICKS);
+    return true;
+}
+
+void thrd_proc(void *arg)
+{
+    coop_tick_t idle_time = (coop_tick_t)(size_t)arg;
+
+    for (int i = 0; i < 3; i++)
+    {
+        coop_tick_t start = coop_tick_cb();
+        coop_idle(idle_time);
+        printf("%s: %d; was idle for %lu\n", coop_thread_name(), i+1,
+            (unsigned long)(coop_tick_cb() - start));
+    }
+    printf("%s EXIT\n", coop_thread_name());
+}
+
+int main(int argc, char *argv[])
+{
+    int chunks = 5;
+
+    coop_idle_work(idle_work, &chunks);
+
+    coop_sched_thread(thrd_proc, "thrd_1", 0, (void*)(size_t)100U);
+    coop_sched_thread(thrd_proc, "thrd_2", 0, (void*)(size_t)50U);
+    coop_sched_service();
+
+    return 0;
+}
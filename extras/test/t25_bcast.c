@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+#include <stdio.h>
+#include "coop_threads.h"
+
+#define RING_SZ 4
+#define SAMPLES 10
+
+/* end of samples marker */
+#define END_SAMPLE -1
+
+static int ring_buf[RING_SZ];
+static coop_bcast_t bc;
+
+static coop_bcast_sub_t sub_fast, sub_slow;
+
+void producer(void *arg)
+{
+    for (int i = 1; i <= SAMPLES + 1; i++)
+    {
+        int *sample = (int*)coop_bcast_claim(&bc);
+
+        *sample = (i <= SAMPLES ? i * 10 : END_SAMPLE);
+        coop_bcast_publish(&bc);
+        coop_yield();
+    }
+    printf("%s: EXIT\n", coop_thread_name());
+}
+
+void subscriber(void *arg)
+{
+    coop_bcast_sub_t *sub = (coop_bcast_sub_t*)arg;
+    bool slow = (sub == &sub_slow);
+    const void *elem;
+
+    while (coop_bcast_get(&bc, sub, &elem, 0) == COOP_SUCCESS)
+    {
+        int sample = *(const int*)elem;
+
+        if (sample == END_SAMPLE) break;
+        printf("%s: sample %d; overruns: %lu\n",
+            coop_thread_name(), sample, coop_bcast_overruns(sub));
+
+        /* slow subscriber lags behind the producer */
+        for (int i = 0; slow && i < 3; i++) coop_yield();
+    }
+
+    if (!slow && coop_bcast_get(&bc, sub, &elem, 10) == COOP_ERR_TIMEOUT) {
+        printf("%s: time-out\n", coop_thread_name());
+    }
+    printf("%s: EXIT\n", coop_thread_name());
+}
+
+int main(int argc, char *argv[])
+{
+    coop_bcast_init(&bc, ring_buf, sizeof(ring_buf[0]), RING_SZ);
+    coop_bcast_subscribe(&bc, &sub_fast);
+    coop_bcast_subscribe(&bc, &sub_slow);
+
+    coop_sched_thread(subscriber, "fast", 0, &sub_fast);
+    coop_sched_thread(subscriber, "slow", 0, &sub_slow);
+    coop_sched_thread(producer, "producer", 0, NULL);
+    coop_sched_service();
+
+    return 0;
+}
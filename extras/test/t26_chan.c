@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "coop_threads.h"
+
+#define CHAN_NAME "/coop_t26"
+#define BAD_CHAN_NAME "/coop_t26_bad"
+
+/* small channel capacity forces the sender to wait for the receiver */
+#define CHAN_MSGS 2
+#define MSGS 6
+
+typedef struct {
+    int seq;
+    char text[16];
+} msg_t;
+
+static coop_chan_t ch;
+
+/* sending process thread; sends messages from @c arg sequence up to half of
+   the messages (1st session) or all of them (2nd session) */
+void sender(void *arg)
+{
+    int first = (int)(intptr_t)arg;
+    void *slot;
+
+    /* wait for the receiving process to create the channel */
+    while (coop_chan_open(&ch, CHAN_NAME) != COOP_SUCCESS) coop_idle(1);
+
+    for (int i = first; i <= (first == 1 ? MSGS / 2 : MSGS); i++)
+    {
+        msg_t *msg;
+
+        if (coop_chan_claim(&ch, &slot, 0) != COOP_SUCCESS) break;
+        msg = (msg_t*)slot;
+
+        msg->seq = i;
+        snprintf(msg->text, sizeof(msg->text), "message %d", i);
+        coop_chan_send(&ch);
+    }
+    coop_chan_close(&ch);
+}
+
+/* receiving process thread */
+void receiver(void *arg)
+{
+    const void *msg;
+
+    for (int i = 1; i <= MSGS; i++)
+    {
+        if (coop_chan_recv(&ch, &msg, 0) != COOP_SUCCESS) break;
+
+        printf("%s: %d: %s\n", coop_thread_name(),
+            ((const msg_t*)msg)->seq, ((const msg_t*)msg)->text);
+        coop_chan_release(&ch);
+
+        /* let the sender fill the channel up */
+        coop_idle(5);
+    }
+
+    if (coop_chan_recv(&ch, &msg, 10) == COOP_ERR_TIMEOUT) {
+        printf("%s: time-out\n", coop_thread_name());
+    }
+    coop_chan_close(&ch);
+}
+
+/* channel segment shorter than declared by its header is refused */
+static void bad_chan(void)
+{
+    coop_chan_t bad, tx;
+    int fd;
+
+    if (coop_chan_create(&bad, BAD_CHAN_NAME, 64, 4) != COOP_SUCCESS) {
+        printf("Channel creation failed\n");
+        return;
+    }
+    if ((fd = shm_open(BAD_CHAN_NAME, O_RDWR, 0)) >= 0) {
+        if (ftruncate(fd, 64) < 0) {}
+        close(fd);
+    }
+
+    printf("malformed channel open: %s\n",
+        (coop_chan_open(&tx, BAD_CHAN_NAME) == COOP_ERR_INV_ARG ?
+            "refused" : "accepted"));
+    coop_chan_close(&bad);
+}
+
+/* channel with a live sender attached is neither re-opened nor replaced */
+static void busy_chan(void)
+{
+    coop_chan_t rx, tx, tx2;
+
+    if (coop_chan_create(&rx, BAD_CHAN_NAME, 8, 4) != COOP_SUCCESS ||
+        coop_chan_open(&tx, BAD_CHAN_NAME) != COOP_SUCCESS)
+    {
+        printf("Channel set-up failed\n");
+        return;
+    }
+
+    printf("second sender open: %s\n",
+        (coop_chan_open(&tx2, BAD_CHAN_NAME) == COOP_ERR_INV_ARG ?
+            "refused" : "accepted"));
+    printf("busy channel re-create: %s\n",
+        (coop_chan_create(&rx, BAD_CHAN_NAME, 8, 4) == COOP_ERR_INV_ARG ?
+            "refused" : "accepted"));
+
+    coop_chan_close(&tx);
+    coop_chan_close(&rx);
+}
+
+int main(int argc, char *argv[])
+{
+    int status;
+    pid_t pid;
+
+    bad_chan();
+    busy_chan();
+
+    fflush(stdout);
+    if (!(pid = fork())) {
+        coop_sched_thread(sender, "sender", 0, (void*)(intptr_t)1);
+        coop_sched_service();
+
+        /* the channel re-opened by another process (pid) is rung by the
+           receiver as well */
+        if (!(pid = fork())) {
+            coop_sched_thread(sender, "sender", 0,
+                (void*)(intptr_t)(MSGS / 2 + 1));
+            coop_sched_service();
+            return 0;
+        }
+        waitpid(pid, &status, 0);
+        return WEXITSTATUS(status);
+    }
+
+    if (coop_chan_create(&ch, CHAN_NAME, sizeof(msg_t), CHAN_MSGS) !=
+        COOP_SUCCESS)
+    {
+        printf("Channel creation failed\n");
+        return 1;
+    }
+    coop_sched_thread(receiver, "receiver", 0, NULL);
+    coop_sched_service();
+
+    waitpid(pid, &status, 0);
+    printf("sender process exit status: %d\n", WEXITSTATUS(status));
+
+    return 0;
+}
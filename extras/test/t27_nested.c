@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+#include <stdio.h>
+#include "coop_threads.h"
+
+/* host thread stack embraces the child scheduler and its threads stacks */
+#define HOST_STACK_SZ 0x8000
+
+#define SEM_WAKE 1
+
+/* virtual clock */
+static coop_tick_t tick = 0;
+
+coop_tick_t coop_tick_cb()
+{
+    return tick;
+}
+
+void coop_idle_cb(coop_tick_t period)
+{
+    printf("coop_idle_cb(%lu) called-back\n", (unsigned long)period);
+    tick += period;
+}
+
+void idle_proc(void *arg)
+{
+    coop_tick_t idle_time = (coop_tick_t)(size_t)arg;
+
+    for (int i = 0; i < 3; i++) {
+        coop_idle(idle_time);
+        printf("%s: %d; tick %lu\n",
+            coop_thread_name(), i+1, (unsigned long)tick);
+    }
+    printf("%s EXIT\n", coop_thread_name());
+}
+
+void child_main(void *arg)
+{
+    /* scheduled into the child scheduler pool */
+    coop_sched_thread(idle_proc, "child_1", 0, (void*)(size_t)20U);
+    coop_sched_thread(idle_proc, "child_2", 0, (void*)(size_t)45U);
+    printf("%s EXIT\n", coop_thread_name());
+}
+
+void host_proc(void *arg)
+{
+    if (coop_sched_nested(child_main, "child_main", 0, NULL) == COOP_SUCCESS) {
+        printf("%s: child scheduler finished; tick %lu\n",
+            coop_thread_name(), (unsigned long)tick);
+    }
+}
+
+void waiter_proc(void *arg)
+{
+    /* the only child thread waits infinitely */
+    if (coop_wait(SEM_WAKE, 0) == COOP_SUCCESS) {
+        printf("%s: notified; tick %lu\n",
+            coop_thread_name(), (unsigned long)tick);
+    }
+}
+
+void waiter_host_proc(void *arg)
+{
+    if (coop_sched_nested(waiter_proc, "waiter", 0, NULL) == COOP_SUCCESS) {
+        printf("%s: child scheduler finished; tick %lu\n",
+            coop_thread_name(), (unsigned long)tick);
+    }
+}
+
+void notifier_proc(void *arg)
+{
+    bool all = (arg != NULL);
+
+    coop_idle(100);
+    printf("%s: notifying%s; tick %lu\n",
+        coop_thread_name(), (all ? " all" : ""), (unsigned long)tick);
+    if (all) {
+        coop_notify_all(SEM_WAKE);
+    } else {
+        coop_notify(SEM_WAKE);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    coop_sched_thread(idle_proc, "parent_1", 0, (void*)(size_t)30U);
+    coop_sched_thread(host_proc, "host", HOST_STACK_SZ, NULL);
+    coop_sched_service();
+
+    /* host waits infinitely in the parent till its child is notified */
+    coop_sched_thread(notifier_proc, "notifier", 0, NULL);
+    coop_sched_thread(waiter_host_proc, "host", HOST_STACK_SZ, NULL);
+    coop_sched_service();
+
+    /* notify-all wakes waiters of both schedulers */
+    coop_sched_thread(waiter_proc, "parent_waiter", 0, NULL);
+    coop_sched_thread(notifier_proc, "notifier", 0, (void*)1);
+    coop_sched_thread(waiter_host_proc, "host", HOST_STACK_SZ, NULL);
+    coop_sched_service();
+
+    return 0;
+}
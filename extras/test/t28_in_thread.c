@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+#include <stdio.h>
+#include "coop_threads.h"
+
+/* virtual clock */
+static coop_tick_t tick = 0;
+
+coop_tick_t coop_tick_cb()
+{
+    return tick;
+}
+
+void coop_idle_cb(coop_tick_t period)
+{
+    printf("coop_idle_cb(%lu) called-back; in thread: %d\n",
+        (unsigned long)period, coop_in_thread());
+    tick += period;
+}
+
+void thrd_proc(void *arg)
+{
+    for (int i = 0; i < 2; i++)
+    {
+        printf("%s: %d; in thread: %d\n",
+            coop_thread_name(), i+1, coop_in_thread());
+        coop_idle((coop_tick_t)(size_t)arg);
+    }
+    printf("%s EXIT; in thread: %d\n", coop_thread_name(), coop_in_thread());
+}
+
+int main(int argc, char *argv[])
+{
+    printf("main: in thread: %d\n", coop_in_thread());
+
+    coop_sched_thread(thrd_proc, "thrd_1", 0, (void*)(size_t)100U);
+    coop_sched_thread(thrd_proc, "thrd_2", 0, (void*)(size_t)50U);
+    coop_sched_service();
+
+    printf("main: in thread: %d\n", coop_in_thread());
+    return 0;
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "coop_threads.h"
+
+/* host thread stack embraces the child scheduler and its threads stacks */
+#define HOST_STACK_SZ 0x8000
+
+static char *shared = NULL;
+static char *outer = NULL;
+static char *child_blk = NULL;
+
+void coop_mem_limit_cb(const char *name, size_t size)
+{
+    printf("coop_mem_limit_cb(%s, %lu) called-back\n",
+        name, (unsigned long)size);
+}
+
+static void print_stats(void)
+{
+    coop_thrd_stats_t stats;
+
+    assert(coop_thread_stats(COOP_CUR_THRD, &stats) == COOP_SUCCESS);
+    printf("%s: cur: %lu, peak: %lu, total: %lu\n", stats.name,
+        (unsigned long)stats.mem_cur, (unsigned long)stats.mem_peak,
+        (unsigned long)stats.mem_total);
+}
+
+static void thrd_alloc(void *arg)
+{
+    char *p1, *p2, *dup;
+
+    coop_thread_mem_limit(1000);
+
+    p1 = malloc(100);
+    p2 = calloc(10, 20);
+    assert(p1 && p2 && !p2[0] && !p2[199]);
+    print_stats();
+
+    /* the block is moved (and its content preserved) */
+    strcpy(p1, "legacy");
+    p1 = realloc(p1, 300);
+    assert(p1 && !strcmp(p1, "legacy"));
+    print_stats();
+
+    /* limit exceeded */
+    assert(!malloc(600));
+
+    /* allocated by the platform library; not accounted */
+    dup = strdup("not accounted");
+    free(dup);
+
+    /* allocated outside of the thread routines */
+    free(outer);
+
+    free(p1);
+    print_stats();
+
+    /* block freed by other thread */
+    shared = p2;
+    coop_yield();
+
+    print_stats();
+    printf("%s EXIT\n", coop_thread_name());
+}
+
+static void thrd_free(void *arg)
+{
+    while (!shared) coop_yield();
+    free(shared);
+
+    print_stats();
+    printf("%s EXIT\n", coop_thread_name());
+}
+
+static void thrd_getline(void *arg)
+{
+    char *buf;
+    size_t n = 16;
+    FILE *f = fmemopen("line longer than the buffer\n", 28, "r");
+
+    assert(f);
+
+    /* the block is reallocated by the platform library directly */
+    buf = malloc(n);
+    assert(buf);
+    assert(getline(&buf, &n, f) == 28);
+    assert(!strcmp(buf, "line longer than the buffer\n"));
+    fclose(f);
+    free(buf);
+
+    /* charge of the block reallocated by the library remains */
+    print_stats();
+    printf("%s EXIT\n", coop_thread_name());
+}
+
+static void child_alloc(void *arg)
+{
+    /* block freed by a thread of the parent scheduler */
+    child_blk = malloc(50);
+    assert(child_blk);
+    print_stats();
+
+    while (child_blk) coop_yield();
+
+    print_stats();
+    printf("%s EXIT\n", coop_thread_name());
+}
+
+static void host_proc(void *arg)
+{
+    assert(coop_sched_nested(child_alloc, "child_alloc", 0, NULL) ==
+        COOP_SUCCESS);
+}
+
+static void parent_free(void *arg)
+{
+    while (!child_blk) coop_yield();
+    free(child_blk);
+    child_blk = NULL;
+
+    print_stats();
+    printf("%s EXIT\n", coop_thread_name());
+}
+
+int main(int argc, char *argv[])
+{
+    /* not accounted */
+    outer = malloc(10);
+    assert(outer);
+
+    coop_sched_thread(thrd_alloc, "thrd_alloc", 0, NULL);
+    coop_sched_thread(thrd_free, "thrd_free", 0, NULL);
+    coop_sched_thread(thrd_getline, "thrd_getline", 0, NULL);
+    coop_sched_service();
+
+    coop_sched_thread(host_proc, "host", HOST_STACK_SZ, NULL);
+    coop_sched_thread(parent_free, "parent_free", 0, NULL);
+    coop_sched_service();
+
+    return 0;
+}
@@ -34,6 +34,150 @@
 # define CONFIG_OPT_STACK_WM
 #endif
 
+#ifdef T10
+# define CONFIG_OPT_WAIT
+# define CONFIG_OPT_IDLE
+# define CONFIG_OPT_MUTEX
+#endif
+
+#ifdef T11
+# define CONFIG_OPT_WAIT
+# define CONFIG_OPT_IDLE
+# define CONFIG_OPT_WAIT_ADDR
+# define CONFIG_WAIT_ADDR_BUCKETS 1
+#endif
+
+#ifdef T12
+# define CONFIG_OPT_WAIT
+# define CONFIG_OPT_IDLE
+# define CONFIG_IDLE_CB_ALT
+# define CONFIG_OPT_RING
+#endif
+
+#ifdef T13
+# define CONFIG_OPT_IDLE
+# define CONFIG_OPT_WAIT
+# define CONFIG_OPT_WAIT_POLL
+# define CONFIG_UNIX_SYSCALL_WRAP
+#endif
+
+#ifdef T14
+# define CONFIG_OPT_RCU
+#endif
+
+#ifdef T15
+# define CONFIG_OPT_MALLOC
+# define CONFIG_MALLOC_ARENA_SIZE 0x280U
+# define CONFIG_MALLOC_CLASSES 4
+#endif
+
+#ifdef T16
+# define CONFIG_OPT_MALLOC
+# define CONFIG_OPT_STATS
+# define CONFIG_MEM_LIMIT_CB_ALT
+# define CONFIG_MALLOC_ARENA_SIZE 0x400U
+# define CONFIG_MALLOC_CLASSES 5
+#endif
+
+#ifdef T17
+# define CONFIG_OPT_IDLE
+# define CONFIG_OPT_WAIT
+# define CONFIG_OPT_STACK_WM
+# define CONFIG_OPT_STATS
+#endif
+
+#ifdef T18
+# define CONFIG_OPT_IDLE
+# define CONFIG_OPT_WAIT
+# define CONFIG_OPT_MUTEX
+# define CONFIG_OPT_WAIT_ADDR
+# define CONFIG_OPT_PROF
+# define CONFIG_WAIT_ADDR_BUCKETS 4
+# define CONFIG_PROF_ENTRIES 3
+#endif
+
+#ifdef T19
+# define CONFIG_OPT_IDLE
+# define CONFIG_OPT_WAIT
+# define CONFIG_OPT_REMOTE_SPAWN
+# define CONFIG_REMOTE_SPAWN_QUEUE 4
+#endif
+
+#ifdef T20
+# define CONFIG_OPT_STACK_WM
+# define CONFIG_OPT_STACK_WM_SP
+#endif
+
+#ifdef T21
+# define CONFIG_OPT_STACK_CANARY
+# define CONFIG_STACK_OVERFLOW_CB_ALT
+#endif
+
+#ifdef T22
+# define CONFIG_OPT_STACK_WM
+# define CONFIG_OPT_STACK_LEARN
+# define CONFIG_STACK_LEARN_MARGIN 0x40U
+# define CONFIG_STACK_LEARN_FILE "t22.learn"
+#endif
+
+#ifdef T23
+# define CONFIG_OPT_IDLE
+# define CONFIG_OPT_WAIT
+# define CONFIG_OPT_EXT_TICK
+/* virtual clock */
+# define CONFIG_TICK_CB_ALT
+# define CONFIG_IDLE_CB_ALT
+#endif
+
+#ifdef T24
+# define CONFIG_OPT_IDLE
+# define CONFIG_OPT_IDLE_WORK
+/* virtual clock */
+# define CONFIG_TICK_CB_ALT
+# define CONFIG_IDLE_CB_ALT
+#endif
+
+#ifdef T25
+# define CONFIG_OPT_WAIT
+# define CONFIG_OPT_BCAST
+#endif
+
+#ifdef T26
+# define CONFIG_OPT_IDLE
+# define CONFIG_OPT_WAIT
+# define CONFIG_OPT_WAIT_POLL
+# define CONFIG_OPT_CHAN
+#endif
+
+#ifdef T27
+# define CONFIG_OPT_IDLE
+# define CONFIG_OPT_WAIT
+# define CONFIG_OPT_WAIT_POLL
+# define CONFIG_OPT_STACK_CANARY
+# define CONFIG_OPT_NESTED_SCHED
+/* virtual clock */
+# define CONFIG_TICK_CB_ALT
+# define CONFIG_IDLE_CB_ALT
+#endif
+
+#ifdef T28
+# define CONFIG_OPT_IDLE
+/* virtual clock */
+# define CONFIG_TICK_CB_ALT
+# define CONFIG_IDLE_CB_ALT
+#endif
+
+#ifdef T29
+# define CONFIG_OPT_STATS
+# define CONFIG_OPT_NESTED_SCHED
+# define CONFIG_UNIX_MALLOC_WRAP
+# define CONFIG_MEM_LIMIT_CB_ALT
+#endif
+
 #ifdef ST01
 # define CONFIG_OPT_IDLE
+# define CONFIG_OPT_WAIT
+/* virtual clock */
+# define CONFIG_TICK_CB_ALT
+# define CONFIG_IDLE_CB_ALT
 #endif
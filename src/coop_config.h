@@ -44,11 +44,222 @@
  */
 #define CONFIG_OPT_WAIT
 
+/**
+ * Enable feature: extended (64-bit) idle/wait deadlines. Idle periods and
+ * waiting timeouts (see @ref coop_period_t) are not limited by
+ * @ref COOP_MAX_PERIOD; a thread idle or waiting for a long period is woken-up
+ * once, at its deadline.
+ *
+ * @note Wrap-arounds of the platform clock are tracked by the scheduler,
+ *     therefore a thread shall not run without yielding for longer than
+ *     @ref COOP_MAX_PERIOD.
+ */
+//#define CONFIG_OPT_EXT_TICK
+
+/**
+ * Enable feature: @ref coop_idle_work() support - background work performed
+ * while all threads are idle.
+ *
+ * @note The feature requires @ref CONFIG_OPT_IDLE.
+ */
+//#define CONFIG_OPT_IDLE_WORK
+
 /**
  * Enable feature: @ref coop_stack_wm() support.
  */
 //#define CONFIG_OPT_STACK_WM
 
+/**
+ * Enable feature: @ref coop_stack_wm_sp() support (stack usage water-mark
+ * based on stack pointer sampling). Unless @ref CONFIG_OPT_STACK_WM is
+ * enabled, threads stacks are not padded on allocation.
+ */
+//#define CONFIG_OPT_STACK_WM_SP
+
+/**
+ * Enable feature: threads stacks overflow detection. A canary word placed
+ * beyond each thread stack far end is verified on every thread switch-out;
+ * @ref coop_stack_overflow_cb() is called-back if overwritten.
+ */
+//#define CONFIG_OPT_STACK_CANARY
+
+/**
+ * Enable feature: learned threads stack sizes persisted across runs. Stack
+ * usage water-mark of a named thread is saved via
+ * @ref coop_stack_learn_save_cb() on the thread termination (or by
+ * @ref coop_stack_learn_save()). @ref coop_sched_thread() called with 0 stack
+ * size uses the learned size (see @ref coop_stack_learn_load_cb()) increased
+ * by @ref CONFIG_STACK_LEARN_MARGIN.
+ *
+ * @note The feature requires @ref CONFIG_OPT_STACK_WM or
+ *     @ref CONFIG_OPT_STACK_WM_SP.
+ */
+//#define CONFIG_OPT_STACK_LEARN
+
+/**
+ * Safety margin added to a learned thread stack size.
+ *
+ * @note The configuration parameter is valid only if
+ *     @ref CONFIG_OPT_STACK_LEARN is enabled.
+ */
+#define CONFIG_STACK_LEARN_MARGIN 0x40U
+
+/**
+ * UNIX only: file the learned stack sizes are persisted in by the default
+ * implementation of the stack learning callbacks.
+ *
+ * @note The configuration parameter is valid only if
+ *     @ref CONFIG_OPT_STACK_LEARN is enabled.
+ */
+#define CONFIG_STACK_LEARN_FILE "coop_stack.learn"
+
+/**
+ * Enable feature: @ref coop_mutex_lock(), @ref coop_mutex_unlock() support.
+ *
+ * @note The feature requires @ref CONFIG_OPT_WAIT.
+ */
+//#define CONFIG_OPT_MUTEX
+
+/**
+ * Enable feature: @ref coop_wait_addr(), @ref coop_wake_addr() support.
+ *
+ * @note The feature requires @ref CONFIG_OPT_WAIT.
+ */
+//#define CONFIG_OPT_WAIT_ADDR
+
+/**
+ * Number of wait-queues (buckets) threads waiting via @ref coop_wait_addr()
+ * are hashed into by the waiting address. Waking-up cost is proportional to
+ * the number of threads waiting on a bucket.
+ *
+ * @note The configuration parameter is valid only if
+ *     @ref CONFIG_OPT_WAIT_ADDR is enabled.
+ */
+#define CONFIG_WAIT_ADDR_BUCKETS 4
+
+/**
+ * Enable feature: @ref coop_ring_put(), @ref coop_ring_get() support.
+ *
+ * @note The feature requires @ref CONFIG_OPT_WAIT.
+ */
+//#define CONFIG_OPT_RING
+
+/**
+ * Enable feature: @ref coop_bcast_publish(), @ref coop_bcast_get() support -
+ * single-producer broadcast ring with per-subscriber cursors.
+ *
+ * @note The feature requires @ref CONFIG_OPT_WAIT.
+ */
+//#define CONFIG_OPT_BCAST
+
+/**
+ * Enable feature: @ref coop_wait_poll() support - waiting for a poll-predicate
+ * evaluated by the scheduler.
+ *
+ * @note The feature requires @ref CONFIG_OPT_WAIT.
+ */
+//#define CONFIG_OPT_WAIT_POLL
+
+/**
+ * Enable feature: inter-process channels over shared memory;
+ * @ref coop_chan_create(), @ref coop_chan_open() support. Linux only.
+ *
+ * @note The feature requires @ref CONFIG_OPT_WAIT_POLL.
+ */
+//#define CONFIG_OPT_CHAN
+
+/**
+ * Enable feature: contention profiler; @ref coop_prof_report() support.
+ *
+ * @note The feature requires @ref CONFIG_OPT_WAIT.
+ */
+//#define CONFIG_OPT_PROF
+
+/**
+ * Max number of synchronization points (semaphore ids, synchronization
+ * objects) profiled by the contention profiler.
+ *
+ * @note The configuration parameter is valid only if @ref CONFIG_OPT_PROF
+ *     is enabled.
+ */
+#define CONFIG_PROF_ENTRIES 8
+
+/**
+ * Enable feature: RCU (read-copy-update) support; @ref coop_synchronize_rcu(),
+ * @ref coop_call_rcu().
+ */
+//#define CONFIG_OPT_RCU
+
+/**
+ * Enable feature: @ref coop_malloc(), @ref coop_free() support.
+ */
+//#define CONFIG_OPT_MALLOC
+
+/**
+ * Size (in bytes) of the static memory arena @ref coop_malloc() allocates
+ * memory blocks from.
+ *
+ * @note The configuration parameter is valid only if @ref CONFIG_OPT_MALLOC
+ *     is enabled.
+ */
+#define CONFIG_MALLOC_ARENA_SIZE 0x400U
+
+/**
+ * Number of memory blocks size classes. Size of the smallest class is equal
+ * to 8 bytes, each next class is twice the size of the previous one (that is
+ * the default 5 classes cover memory blocks up to 128 bytes).
+ *
+ * @note The configuration parameter is valid only if @ref CONFIG_OPT_MALLOC
+ *     is enabled.
+ */
+#define CONFIG_MALLOC_CLASSES 5
+
+/**
+ * If configured, @ref coop_malloc() requests not served by the size classes
+ * (larger than the largest class or due to exhausted arena) are passed to the
+ * platform @c malloc(). Otherwise @ref coop_malloc() fails in this case.
+ *
+ * @note The configuration parameter is valid only if @ref CONFIG_OPT_MALLOC
+ *     is enabled.
+ */
+//#define CONFIG_MALLOC_FALLBACK
+
+/**
+ * Enable feature: threads statistics; @ref coop_thread_stats() support.
+ *
+ * If configured together with @ref CONFIG_OPT_MALLOC, memory allocated by
+ * @ref coop_malloc() is accounted for the allocating threads and per-thread
+ * memory limits may be set by @ref coop_thread_mem_limit(). The same applies
+ * to the platform heap with @ref CONFIG_UNIX_MALLOC_WRAP.
+ *
+ * Live statistics may be exported into a buffer attached by an external viewer
+ * (see @ref coop_stats_export(), @ref coop_stats_shm_export()).
+ */
+//#define CONFIG_OPT_STATS
+
+/**
+ * Enable feature: @ref coop_spawn_remote() support - threads spawned from
+ * other OS threads.
+ */
+//#define CONFIG_OPT_REMOTE_SPAWN
+
+/**
+ * Size of the remote spawn injection queue. Must be a power of 2.
+ *
+ * @note The configuration parameter is valid only if
+ *     @ref CONFIG_OPT_REMOTE_SPAWN is enabled.
+ */
+#define CONFIG_REMOTE_SPAWN_QUEUE 8
+
+/**
+ * Enable feature: @ref coop_sched_nested() support - threads running their own
+ * child schedulers.
+ *
+ * @note The feature can't be configured together with
+ *     @ref CONFIG_NOEXIT_STATIC_THREADS and @ref CONFIG_OPT_REMOTE_SPAWN.
+ */
+//#define CONFIG_OPT_NESTED_SCHED
+
 /**
  * If the library is used to create static number of threads at its startup
  * and the threads are not intended to exit, this parameter may be configured
@@ -63,6 +274,74 @@
  */
 //#define CONFIG_NOEXIT_STATIC_THREADS
 
+/**
+ * Alternative implementation of @ref coop_mem_limit_cb() callback.
+ * Default implementation depends on the underlying platform.
+ *
+ * @note The configuration parameter is valid only if @ref CONFIG_OPT_STATS
+ *     is enabled together with @ref CONFIG_OPT_MALLOC or
+ *     @ref CONFIG_UNIX_MALLOC_WRAP.
+ */
+//#define CONFIG_MEM_LIMIT_CB_ALT
+
+/**
+ * Alternative implementation of @ref coop_stack_overflow_cb() callback.
+ * Default implementation depends on the underlying platform.
+ *
+ * @note The configuration parameter is valid only if @ref
+ *     CONFIG_OPT_STACK_CANARY is enabled.
+ */
+//#define CONFIG_STACK_OVERFLOW_CB_ALT
+
+/**
+ * Alternative implementation of @ref coop_stack_learn_load_cb() and
+ * @ref coop_stack_learn_save_cb() callbacks (e.g. persisting the learned stack
+ * sizes in EEPROM/NVS). Default implementation depends on the underlying
+ * platform.
+ *
+ * @note The configuration parameter is valid only if
+ *     @ref CONFIG_OPT_STACK_LEARN is enabled.
+ */
+//#define CONFIG_STACK_LEARN_CB_ALT
+
+/**
+ * Arduino only: override Arduino core @c yield() hook to yield the current
+ * thread to the scheduler if called from a thread routine. Since Arduino's
+ * @c delay() calls @c yield() while waiting, delays in thread routines
+ * (including third-party libraries code) don't block other threads.
+ *
+ * @note Such a delay is a cooperative busy-wait: the system idle state
+ *     (@ref coop_idle_cb()) is not entered while any thread is delaying. Use
+ *     @ref coop_idle() where the platform shall sleep.
+ *
+ * @note Supported for Arduino cores with @c yield() defined as a weak,
+ *     empty hook (e.g. AVR, SAMD). Not supported for ESP8266, ESP32.
+ */
+//#define CONFIG_ARDUINO_YIELD_HOOK
+
+/**
+ * UNIX only: enable blocking system calls interposition layer (sleeps, read,
+ * write, connect, accept, poll), which makes legacy code calling them
+ * cooperative while called from a thread routine. See
+ * @c src/platform/unix_wrap.c for required linker flags.
+ *
+ * @note The configuration parameter requires @ref CONFIG_OPT_IDLE and
+ *     @ref CONFIG_OPT_WAIT_POLL. It can't be used with @ref CONFIG_OPT_CHAN.
+ */
+//#define CONFIG_UNIX_SYSCALL_WRAP
+
+/**
+ * UNIX only: enable platform heap routines interposition (malloc, calloc,
+ * realloc, free). Application memory allocated by thread routines is accounted
+ * for the allocating threads as done by @ref coop_malloc(), including the
+ * per-thread memory limits. See @c src/platform/unix_wrap.c for required
+ * linker flags and accounting of blocks reallocated by platform libraries
+ * (e.g. getline()).
+ *
+ * @note The configuration parameter requires @ref CONFIG_OPT_STATS.
+ */
+//#define CONFIG_UNIX_MALLOC_WRAP
+
 /**
  * Uncomment to log debugging messages.
  *
@@ -112,5 +391,14 @@
  */
 //#define CONFIG_IDLE_CB_ALT
 
+/**
+ * Alternative implementation of @ref coop_idle_wakeup_cb() callback.
+ * Default implementation depends on the underlying platform.
+ *
+ * @note The configuration parameter is valid only if
+ *     @ref CONFIG_OPT_REMOTE_SPAWN is enabled.
+ */
+//#define CONFIG_IDLE_WAKEUP_CB_ALT
+
 #endif /* !COOP_DISABLE_DEFAULT_CONFIG */
 #endif /* __COOP_CONFIG_H__ */
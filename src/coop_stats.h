@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+/*
+ * Statistics export buffer layout; see coop_stats_export().
+ *
+ * The header is self-contained (doesn't depend on the library configuration),
+ * therefore may be used by external tools (e.g. coop-top) attaching to the
+ * exported statistics.
+ */
+
+#ifndef __COOP_STATS_H__
+#define __COOP_STATS_H__
+
+#include <stdint.h>
+
+/** Export buffer magic ("COST"). */
+#define COOP_STATS_MAGIC 0x434f5354UL
+
+/** Default name of the shared memory segment the statistics are exported to. */
+#define COOP_STATS_SHM_NAME "/coop_stats"
+
+/** Max length of exported thread name (including terminating NULL). */
+#define COOP_STATS_NAME_LEN 16
+
+/**
+ * Exported thread states.
+ */
+typedef enum
+{
+    COOP_STATS_EMPTY = 0,   /**< Not occupied slot */
+    COOP_STATS_NEW,         /**< Scheduled, not yet run */
+    COOP_STATS_RUN,         /**< Running */
+    COOP_STATS_IDLE,        /**< Idle (sleeping) */
+    COOP_STATS_WAIT,        /**< Waiting for notification */
+    COOP_STATS_HOLE         /**< Terminated, stack frame still in use */
+} coop_stats_state_t;
+
+/**
+ * Exported thread statistics.
+ */
+typedef struct
+{
+    /**
+     * Thread name (truncated); empty for unnamed or not occupied slot.
+     * Exported once the thread is scheduled.
+     */
+    char name[COOP_STATS_NAME_LEN];
+
+    /** Thread state (@ref coop_stats_state_t). */
+    uint8_t state;
+
+    /** Reserved. */
+    uint8_t res[7];
+
+    /** Number of clock ticks the thread has been running for. */
+    uint32_t run_ticks;
+
+    /** Number of switches into the thread. */
+    uint32_t switch_n;
+
+    /** Stack usage water-mark; 0 if not supported. */
+    uint32_t stack_wm;
+
+    /** Semaphore id the thread is waiting on; valid if @c wait_obj is 0. */
+    int32_t wait_sem;
+
+    /** Object (wait queue, ring, address) the thread is waiting on or 0. */
+    uint64_t wait_obj;
+
+    /** Number of bytes currently allocated by the thread; 0 if not supported. */
+    uint64_t mem_cur;
+
+    /** Peak memory usage; 0 if not supported. */
+    uint64_t mem_peak;
+} coop_stats_exp_thrd_t;
+
+/**
+ * Exported statistics.
+ *
+ * The buffer is updated under sequence lock: @c seq is odd while the buffer
+ * is being updated. A reader shall copy the buffer and repeat the copy if
+ * @c seq was odd or has changed during the copying.
+ */
+typedef struct coop_stats_exp
+{
+    /** @ref COOP_STATS_MAGIC */
+    uint32_t magic;
+
+    /** Sequence lock counter. */
+    volatile uint32_t seq;
+
+    /** Number of entries in @c thrds. */
+    uint32_t thrds_n;
+
+    /** Clock tick of the latest update. */
+    uint32_t tick;
+
+    /** Total number of switches into threads. */
+    uint32_t switch_n;
+
+    /** Number of system idle callback calls. */
+    uint32_t idle_n;
+
+    /** Number of occupied threads pool slots. */
+    uint32_t busy_n;
+
+    /** Reserved. */
+    uint32_t res;
+
+    /** Threads pool statistics (@c thrds_n entries). */
+    coop_stats_exp_thrd_t thrds[1];
+} coop_stats_exp_t;
+
+/** Size of export buffer for @c _thrds_n threads. */
+#define COOP_STATS_EXP_SIZE(_thrds_n) (sizeof(coop_stats_exp_t) + \
+    ((_thrds_n) - 1) * sizeof(coop_stats_exp_thrd_t))
+
+#endif /* __COOP_STATS_H__ */
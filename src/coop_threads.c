@@ -12,16 +12,36 @@
 
 #include <alloca.h>
 #include <setjmp.h>
-#include <string.h> /* memset() */
+#include <string.h> /* memset(), strncpy() */
 #include "coop_threads.h"
 
 #ifdef CONFIG_NOEXIT_STATIC_THREADS
 # include <assert.h>
 #endif
+#ifdef CONFIG_MALLOC_FALLBACK
+# include <stdlib.h> /* malloc(), free() */
+#endif
+#ifdef CONFIG_OPT_STATS
+# include "coop_stats.h"
+#endif
 
 /** Stack padding byte: 0b10100101 */
 #define STACK_PADD  0xA5
 
+#ifdef CONFIG_OPT_STACK_CANARY
+/** Stack canary word. */
+# define STACK_CANARY ((unsigned)0xC3A55A3CUL)
+
+/** Stack size aligned to the canary word. */
+# define _CANARY_ALIGN(_sz) \
+    (((_sz) + sizeof(unsigned) - 1) & ~(sizeof(unsigned) - 1))
+#endif
+
+#if defined(CONFIG_OPT_STACK_WM_SP) || defined(CONFIG_OPT_STACK_CANARY)
+/* stack growth direction detection */
+# define __COOP_STACK_DIR
+#endif
+
 /**
  * Thread states.
  */
@@ -58,6 +78,16 @@ typedef enum
 #define _IS_STARTED(_state) \
     ((_state) == RUN || _IS_IDLE(_state) || _IS_WAIT(_state))
 
+#ifdef CONFIG_OPT_EXT_TICK
+/** Idle/wait deadline type; extended clock tick (see @ref _ext_tick()). */
+typedef coop_period_t coop_deadline_t;
+#else
+/** Idle/wait deadline type; platform clock tick. */
+typedef coop_tick_t coop_deadline_t;
+#endif
+
+#define _MAX_DEADLINE ((coop_deadline_t)-1)
+
 /**
  * Thread context.
  */
@@ -81,7 +111,7 @@ typedef struct
 
 #ifdef CONFIG_OPT_IDLE
     /** Clock tick the thread is idle up to. */
-    coop_tick_t idle_to;
+    coop_deadline_t idle_to;
 #endif
 #ifdef CONFIG_OPT_YIELD_AFTER
     /** Scheduler to thread switch clock tick */
@@ -98,15 +128,59 @@ typedef struct
     void *cv;
 
     /** Clock tick the thread is waiting up to. */
-    coop_tick_t wait_to;
+    coop_deadline_t wait_to;
+# ifdef CONFIG_OPT_PROF
+    /** Clock ticks the thread started waiting and was woken-up at. */
+    coop_tick_t prof_start;
+    coop_tick_t prof_wake;
+# endif
 
     /** Waiting related flags. */
     struct {
         unsigned char notif: 1; /** Notified flag. */
         unsigned char inf:   1; /** Infinite wait; @c wait_to not applied. */
-        unsigned char res:   6; /** Reserved. */
+        unsigned char wq:    1; /** Waiting on a wait queue; @c sem_id not
+                                    applied. */
+        unsigned char ring:  1; /** Waiting on a ring buffer (@c cv); @c sem_id
+                                    not applied. */
+        unsigned char poll:  1; /** Waiting on a poll-predicate (@c predic);
+                                    @c sem_id not applied. */
+        unsigned char res:   3; /** Reserved. */
     } wait_flgs;
 #endif
+#ifdef __COOP_WQ
+    /** Next thread id on the wait queue the thread is waiting on. */
+    unsigned wq_next;
+#endif
+#ifdef CONFIG_OPT_WAIT_ADDR
+    /** Waiting address (@ref coop_wait_addr()). */
+    const void *wait_addr;
+#endif
+#ifdef __COOP_MEM_STATS
+    /** Thread generation tagging memory blocks owned by the thread. */
+    unsigned mem_gen;
+
+    /** Memory usage accounting; see @ref coop_thrd_stats_t. */
+    size_t mem_cur;
+    size_t mem_peak;
+    size_t mem_total;
+    size_t mem_limit;
+#endif
+#ifdef CONFIG_OPT_STATS
+    /** Number of clock ticks the thread has been running for. */
+    coop_tick_t run_ticks;
+
+    /** Number of switches into the thread. */
+    unsigned long switch_n;
+#endif
+#ifdef CONFIG_OPT_STACK_WM_SP
+    /** Deepest sampled stack pointer (NULL if the stack is not allocated). */
+    unsigned char *sp_wm;
+#endif
+#ifdef CONFIG_OPT_STACK_CANARY
+    /** Stack canary word (NULL if the stack is not allocated). */
+    unsigned *canary;
+#endif
 #ifndef CONFIG_NOEXIT_STATIC_THREADS
     /**
      * Thread stack depth on the main stack. 1 for the first started (deepest)
@@ -124,7 +198,7 @@ typedef struct
 /**
  * Scheduler context.
  */
-typedef struct
+typedef struct coop_sched_ctx
 {
     /** Scheduler currently processed thread. */
     unsigned cur_thrd;
@@ -132,6 +206,9 @@ typedef struct
     /** Number of occupied (non empty) thread slots. */
     unsigned busy_n;
 
+    /** Control passed to the current thread routine. */
+    bool in_thrd;
+
 #ifdef CONFIG_OPT_IDLE
     /** Number of idle and waiting threads. */
     unsigned idle_n;
@@ -142,15 +219,132 @@ typedef struct
 
     /** Number of threads currently occupying the main stack. */
     unsigned depth;
+#endif
+#ifdef __COOP_STACK_DIR
+    /** Threads stacks grow into lower addresses. */
+    bool stack_down;
+#endif
+#ifdef CONFIG_OPT_IDLE_WORK
+    /** Registered idle-work routine and its argument. */
+    coop_idle_work_proc_t idle_work;
+    void *idle_work_arg;
+#endif
+#ifdef CONFIG_OPT_EXT_TICK
+    /** Extended clock tick and the platform clock tick it was updated at. */
+    coop_period_t ext_tick;
+    coop_tick_t ext_tick_last;
+#endif
+#ifdef CONFIG_OPT_STACK_LEARN
+    /** Learned stack size of a terminated thread pending to be saved. */
+    const char *learn_name;
+    size_t learn_wm;
+#endif
+#ifdef CONFIG_OPT_RCU
+    /** Queued RCU callbacks. */
+    coop_rcu_head_t *rcu_head;
+    coop_rcu_head_t *rcu_tail;
+#endif
+#ifdef CONFIG_OPT_WAIT_ADDR
+    /** Wait-queues of threads waiting on addresses. */
+    coop_wq_t addr_wqs[CONFIG_WAIT_ADDR_BUCKETS];
+#endif
+#ifdef CONFIG_OPT_STATS
+    /** Clock tick of the latest switch into or out of the current thread. */
+    coop_tick_t switch_tick;
+
+    /** Total number of switches into threads. */
+    unsigned long switch_n;
+
+    /** Number of system idle callback calls. */
+    unsigned long idle_n_cb;
+
+    /** Statistics export buffer (may be NULL). */
+    coop_stats_exp_t *stats_exp;
 #endif
     /** Scheduler execution context. */
     jmp_buf exe_ctx;
 
+#ifdef CONFIG_OPT_NESTED_SCHED
+    /** Parent scheduler of a child scheduler; NULL for the root scheduler. */
+    struct coop_sched_ctx *parent;
+
+    /** Next scheduler on the list of running schedulers (the root first). */
+    struct coop_sched_ctx *next;
+#endif
     /** Threads pool of contexts. */
     coop_thrd_ctx_t thrds[CONFIG_MAX_THREADS];
 } coop_sched_ctx_t;
 
+#ifdef CONFIG_OPT_RING
+/*
+ * Data put into a ring buffer since last check by a scheduler. Not a part of
+ * the scheduler context, since may be set by ISRs while any of the nested
+ * schedulers is running.
+ */
+static volatile bool ring_pend = false;
+#endif
+
+#ifdef CONFIG_OPT_NESTED_SCHED
+static coop_sched_ctx_t root_sched = {0};
+
+/* currently running scheduler (the root or a child one) */
+static coop_sched_ctx_t *cur_sched = &root_sched;
+# define sched (*cur_sched)
+#else
 static coop_sched_ctx_t sched = {0};
+#endif
+
+#ifdef CONFIG_OPT_REMOTE_SPAWN
+/**
+ * Remote spawn request (injection queue cell).
+ */
+typedef struct
+{
+    /**
+     * Cell sequence number, stored relative to the cell index (so the zeroed
+     * queue is initialized). Equal to the enqueue position if the cell is
+     * free, to the position + 1 if the cell contains the request.
+     */
+    unsigned seq;
+
+    coop_thrd_proc_t proc;
+    const char *name;
+    size_t stack_sz;
+    void *arg;
+} coop_spawn_cell_t;
+
+/**
+ * Remote spawn injection queue (bounded lock-free MPSC queue). Kept outside
+ * the scheduler context since accessed by other OS threads.
+ */
+static struct
+{
+    /** Enqueue position (producers). */
+    unsigned enq_pos;
+
+    /** Dequeue position (the scheduler). */
+    unsigned deq_pos;
+
+    coop_spawn_cell_t cells[CONFIG_REMOTE_SPAWN_QUEUE];
+} spawn_q;
+
+# define _SPAWN_CELL_IDX(_pos) ((_pos) & (CONFIG_REMOTE_SPAWN_QUEUE - 1))
+#endif
+
+#ifdef CONFIG_OPT_PROF
+/**
+ * Contention profiler context. Kept outside the scheduler context to survive
+ * the scheduler sessions.
+ */
+static struct
+{
+    /** Number of occupied entries. */
+    unsigned n;
+
+    /** Profiled synchronization points. */
+    coop_prof_stats_t ents[CONFIG_PROF_ENTRIES];
+} prof_ctx;
+#endif
 
 #ifdef CONFIG_NOEXIT_STATIC_THREADS
 # define _ACTIVE_THREADS() (sched.busy_n)
@@ -158,7 +352,40 @@ static coop_sched_ctx_t sched = {0};
 # define _ACTIVE_THREADS() (sched.busy_n - sched.hole_n)
 #endif
 
-#ifdef COOP_DEBUG
+#ifdef CONFIG_OPT_EXT_TICK
+/**
+ * Get the current extended clock tick by accumulating the platform clock
+ * increments since the last call.
+ *
+ * @note Wrap-arounds of the platform clock are tracked as long as the routine
+ *     is called at least once per the wrap-around period. This is the case
+ *     while there are pending idle/wait deadlines (the scheduler samples the
+ *     clock on each pass and the system idle periods are limited to
+ *     @ref COOP_MAX_PERIOD). Lost wrap-arounds while no deadline is pending
+ *     are harmless since the deadlines are relative to the extended tick.
+ */
+static inline coop_period_t _ext_tick(void)
+{
+    register coop_tick_t tick = coop_tick_cb();
+
+    if (!sched.ext_tick) {
+        /* the extended clock starts at 1 at its first sampling */
+        sched.ext_tick_last = tick;
+        return (sched.ext_tick = 1);
+    }
+    sched.ext_tick += (coop_tick_t)(tick - sched.ext_tick_last);
+    sched.ext_tick_last = tick;
+    return sched.ext_tick;
+}
+
+# define _CUR_TICK() _ext_tick()
+# define _IS_DUE(_cur, _to) ((_cur) >= (_to))
+#else
+# define _CUR_TICK() coop_tick_cb()
+# define _IS_DUE(_cur, _to) COOP_IS_TICK_OVER(_cur, _to)
+#endif
+
+#if defined(COOP_DEBUG) || defined(CONFIG_OPT_STATS)
 static const char *_state_name(unsigned i)
 {
     switch (sched.thrds[i].state)
@@ -191,574 +418,2147 @@ static inline void _sched_init(bool force)
     static bool inited = false;
 
     if (!inited || force) {
+#ifdef CONFIG_OPT_STATS
+        /* export is continued across the scheduler sessions */
+        coop_stats_exp_t *stats_exp = sched.stats_exp;
+#endif
+#ifdef CONFIG_OPT_IDLE_WORK
+        /* so is the idle-work registration */
+        coop_idle_work_proc_t idle_work = sched.idle_work;
+        void *idle_work_arg = sched.idle_work_arg;
+#endif
+#ifdef CONFIG_OPT_NESTED_SCHED
+        /* child scheduler is unlinked after its service exit */
+        coop_sched_ctx_t *parent = sched.parent, *next = sched.next;
+#endif
         inited = true;
         memset(&sched, 0, sizeof(sched));
         sched.cur_thrd = (unsigned)-1;
+#ifdef CONFIG_OPT_STATS
+        sched.stats_exp = stats_exp;
+#endif
+#ifdef CONFIG_OPT_IDLE_WORK
+        sched.idle_work = idle_work;
+        sched.idle_work_arg = idle_work_arg;
+#endif
+#ifdef CONFIG_OPT_NESTED_SCHED
+        sched.parent = parent;
+        sched.next = next;
+#endif
     }
 }
 
-/*
- * NOTE: to reduce stack usage by coop_sched_service() helper routines, these
- * are defined as inline with all their local variables stored in registers.
+/**
+ * Pass control to the current thread.
  */
+static inline void _switch_in(void)
+{
+    sched.in_thrd = true;
+#ifdef CONFIG_OPT_STATS
+    sched.thrds[sched.cur_thrd].switch_n++;
+    sched.switch_n++;
+    sched.switch_tick = coop_tick_cb();
+#endif
+}
 
-#ifndef CONFIG_NOEXIT_STATIC_THREADS
 /**
- * Mark threads whose stacks need to be unwinded.
- *
- * Return terminated thread index at which the unwinded stack shall finish.
- * The new scheduler stack frame will be set at the thread context after the
- * unwinding process completes.
+ * Control passed back from the current thread.
  */
-static inline unsigned _mark_unwind_thrds()
+static inline void _switch_out(void)
 {
-    register unsigned i, depth, unwnd_thrd = sched.cur_thrd;
+    sched.in_thrd = false;
+#ifdef CONFIG_OPT_STACK_CANARY
+    if (sched.thrds[sched.cur_thrd].canary &&
+        *sched.thrds[sched.cur_thrd].canary != STACK_CANARY)
+    {
+        coop_dbg_log_cb("Thread #%d stack overflow\n", sched.cur_thrd);
+        coop_stack_overflow_cb(sched.thrds[sched.cur_thrd].name);
+    }
+#endif
+#ifdef CONFIG_OPT_STATS
+    coop_tick_t tick = coop_tick_cb();
 
-    /* mark the terminating (most shallow) thread as EMPTY */
-    coop_dbg_log_cb("Thread #%d: RUN -> EMPTY\n", sched.cur_thrd);
-    sched.thrds[sched.cur_thrd].state = EMPTY;
-    sched.busy_n--;
+    sched.thrds[sched.cur_thrd].run_ticks += tick - sched.switch_tick;
+    /* reused as the export tick of the following switch export */
+    sched.switch_tick = tick;
+#endif
+}
 
-    /* calculate current main stack depth */
-    for (i = depth = 0; i < CONFIG_MAX_THREADS; i++) {
-        if (_IS_STARTED(sched.thrds[i].state)) {
-            if (depth < sched.thrds[i].depth)
-                depth = sched.thrds[i].depth;
-        }
+#ifdef CONFIG_OPT_STACK_WM
+/**
+ * Get maximum stack usage water-mark for thread @c i.
+ */
+static size_t _stack_wm(unsigned i)
+{
+    size_t stack_sz = sched.thrds[i].stack_sz;
+    unsigned char *stack = (unsigned char*)sched.thrds[i].stack;
+    size_t f, f2; /* free space water-marks */
+
+    if (!stack) {
+        /* stack not yet allocated (the thread hasn't yielded yet) */
+        return 0;
     }
 
-    if (depth + 1 < sched.depth)
-    {
-        /*
-         * All holes between the terminating thread and the most shallow
-         * started thread are marked as EMPTY to indicate stack space occupied
-         * by these threads stacks as to be freed.
-         */
-        for (i = 0; i < CONFIG_MAX_THREADS; i++) {
-            if (sched.thrds[i].state == HOLE) {
-                if (depth + 1 <= sched.thrds[i].depth)
-                {
-                    if (depth + 1 == sched.thrds[i].depth) {
-                        unwnd_thrd = i;
-                    }
-                    coop_dbg_log_cb("Thread #%d: HOLE -> EMPTY\n", i);
-                    sched.thrds[i].state = EMPTY;
-                    sched.busy_n--;
-                    sched.hole_n--;
-                }
-            }
-        }
-    } else {
-        /*
-         * No hole between the most shallow started thread and the terminating
-         * thread. Unwinded stack will be set to the terminating thread stack.
-         */
+    /* first check most common type of stack (growing into lower addresses) */
+    for (f = stack_sz; f && stack[f - 1] == STACK_PADD; f--);
+    f = stack_sz - f;
+
+    if (f < sizeof(void*)) {
+        /* whole stack was filled up or the stack grows into higher addresses */
+        for (f2 = 0; f2 < stack_sz && stack[f2] == STACK_PADD; f2++);
+
+        /* assume growing into higher addresses type of stack */
+        if (f2 > f) f = f2;
     }
-    sched.depth = depth;
+    return (stack_sz - f);
+}
+#endif /* CONFIG_OPT_STACK_WM */
 
-    return unwnd_thrd;
+#ifdef CONFIG_OPT_STACK_WM_SP
+/**
+ * Sample the current thread stack pointer (approximated by @c sp address of
+ * a local variable) for the stack pointer based water-mark.
+ */
+static inline void _stack_sample(unsigned char *sp)
+{
+    unsigned char *sp_wm = sched.thrds[sched.cur_thrd].sp_wm;
+
+    if (sp_wm && (sched.stack_down ? sp < sp_wm : sp > sp_wm)) {
+        sched.thrds[sched.cur_thrd].sp_wm = sp;
+    }
+}
+
+/**
+ * Get stack pointer based water-mark for thread @c i.
+ */
+static size_t _stack_wm_sp(unsigned i)
+{
+    unsigned char *stack = (unsigned char*)sched.thrds[i].stack;
+    unsigned char *sp_wm = sched.thrds[i].sp_wm;
+
+    if (!sp_wm) {
+        /* stack not yet allocated (the thread hasn't yielded yet) */
+        return 0;
+    }
+    return (sched.stack_down ?
+        (size_t)(stack + sched.thrds[i].stack_sz - sp_wm) :
+        (size_t)(sp_wm - stack));
+}
+#endif /* CONFIG_OPT_STACK_WM_SP */
+
+#ifdef CONFIG_OPT_STACK_LEARN
+# ifdef CONFIG_OPT_STACK_WM
+#  define _LEARN_WM(_i) _stack_wm(_i)
+# else
+#  define _LEARN_WM(_i) _stack_wm_sp(_i)
+# endif
+
+/**
+ * Thread @c i is being terminated. Since the stack usage of the saving
+ * callback is unknown, the learned stack size is saved later by the scheduler
+ * on its own stack (see @ref _stack_learn_flush()).
+ */
+static inline void _stack_learn_term(unsigned i)
+{
+    if (sched.thrds[i].name && sched.thrds[i].stack) {
+        sched.learn_name = sched.thrds[i].name;
+        sched.learn_wm = _LEARN_WM(i);
+    }
+}
+
+/**
+ * Save pending learned stack size.
+ */
+static inline void _stack_learn_flush(void)
+{
+    if (sched.learn_name) {
+        coop_stack_learn_save_cb(sched.learn_name, sched.learn_wm);
+        sched.learn_name = NULL;
+    }
+}
+#endif /* CONFIG_OPT_STACK_LEARN */
+
+#if defined(CONFIG_OPT_WAIT) && \
+    (defined(CONFIG_OPT_STATS) || defined(CONFIG_OPT_PROF))
+/**
+ * Object (wait queue owner, ring buffer) the waiting thread @c i is waiting
+ * on or NULL if waiting on a semaphore.
+ */
+static inline const void *_wait_obj(unsigned i)
+{
+    /* wait queue, ring buffer or poll-predicate argument */
+    if (sched.thrds[i].wait_flgs.wq || sched.thrds[i].wait_flgs.ring ||
+        sched.thrds[i].wait_flgs.poll)
+    {
+        return sched.thrds[i].cv;
+    }
+    return NULL;
 }
 #endif
 
-#ifdef CONFIG_OPT_IDLE
+#ifdef CONFIG_OPT_REMOTE_SPAWN
 /**
- * Check conditions and enter the system idle state if necessary.
+ * Move remote spawn requests from the injection queue into the threads pool.
  */
-static inline void _system_idle(void)
+static void _spawn_drain(void)
 {
-    register unsigned i = 0;
-    register coop_tick_t min_idle = 0, cur_tick = 0;
+    register coop_spawn_cell_t *cell;
+    register unsigned k;
 
-    /* system is considered idle-ready if all active threads are idle or waiting */
-    while (sched.idle_n > 0 && _ACTIVE_THREADS() <= sched.idle_n)
+    while (sched.busy_n < CONFIG_MAX_THREADS)
     {
-        if (i) {
-            /* min_idle was set in the previous loop pass */
-# ifdef COOP_DEBUG
-            if (min_idle == COOP_MAX_TICK) {
-                coop_dbg_log_cb("System going idle infinitely\n");
-            } else {
-                coop_dbg_log_cb("System going idle for %lu ticks\n",
-                    (unsigned long)min_idle);
-            }
-# endif
-            /* system is idle up to nearest wake-up time */
-            coop_idle_cb(min_idle == COOP_MAX_TICK ? 0 : min_idle);
+        k = _SPAWN_CELL_IDX(spawn_q.deq_pos);
+        cell = &spawn_q.cells[k];
+
+        if (__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) + k !=
+            spawn_q.deq_pos + 1)
+        {
+            /* no (published) request */
+            break;
         }
 
-        min_idle = COOP_MAX_TICK;
-        cur_tick = coop_tick_cb();  /* current tick */
+        coop_dbg_log_cb("Remote spawn request %u\n", spawn_q.deq_pos);
+        coop_sched_thread(cell->proc, cell->name, cell->stack_sz, cell->arg);
 
-        for (i = 0; i < CONFIG_MAX_THREADS; i++)
-        {
-            if (_IS_IDLE(sched.thrds[i].state)
-# ifdef CONFIG_OPT_WAIT
-                || (_IS_WAIT(sched.thrds[i].state) &&
-                    !sched.thrds[i].wait_flgs.inf)
-# endif
-                )
-            {
-                register coop_tick_t idle_to = (
-# ifdef CONFIG_OPT_WAIT
-                    !_IS_IDLE(sched.thrds[i].state) ? sched.thrds[i].wait_to :
-# endif
-                    sched.thrds[i].idle_to);
+        /* free the cell for the next queue cycle */
+        __atomic_store_n(&cell->seq,
+            spawn_q.deq_pos + CONFIG_REMOTE_SPAWN_QUEUE - k, __ATOMIC_RELEASE);
+        spawn_q.deq_pos++;
+    }
+}
+#endif /* CONFIG_OPT_REMOTE_SPAWN */
 
-                if (COOP_IS_TICK_OVER(cur_tick, idle_to)) {
-                    coop_dbg_log_cb("Thread #%d %s -> RUN (via idle-loop)\n",
-                        i, _state_name(i));
+#ifdef CONFIG_OPT_PROF
+/**
+ * Get profiler entry for a synchronization point or NULL if the profiler
+ * table is full.
+ */
+static coop_prof_stats_t *_prof_entry(int sem_id, const void *obj)
+{
+    register unsigned i;
 
-                    /* idle time passed; the idle-loop will be finished */
-                    sched.thrds[i].state = RUN;
-                    sched.idle_n--;
-                } else
-                if ((idle_to - cur_tick) < min_idle) {
-                    /* calculate nearest wake-up time */
-                    min_idle = (idle_to - cur_tick);
-                }
-            }
+    for (i = 0; i < prof_ctx.n; i++) {
+        if (prof_ctx.ents[i].obj == obj &&
+            (obj || prof_ctx.ents[i].sem_id == sem_id))
+        {
+            return &prof_ctx.ents[i];
         }
     }
+
+    if (prof_ctx.n >= CONFIG_PROF_ENTRIES) {
+        return NULL;
+    }
+    memset(&prof_ctx.ents[i], 0, sizeof(prof_ctx.ents[i]));
+    prof_ctx.ents[i].sem_id = (obj ? 0 : sem_id);
+    prof_ctx.ents[i].obj = obj;
+    prof_ctx.n++;
+
+    return &prof_ctx.ents[i];
 }
-#endif /* CONFIG_OPT_IDLE */
 
-void coop_sched_service(void)
+/**
+ * Account the current thread wait just finished.
+ */
+static void _prof_wait_end(void)
 {
-    while (sched.busy_n > 0)
-    {
-#ifdef CONFIG_OPT_IDLE
+    register coop_thrd_ctx_t *ctx = &sched.thrds[sched.cur_thrd];
+    register coop_prof_stats_t *ent =
+        _prof_entry(ctx->sem_id, _wait_obj(sched.cur_thrd));
+    register coop_tick_t blocked;
+
+    if (!ent) return;
+
+    /* timed-out thread is blocked up to its resumption */
+    blocked = (ctx->wait_flgs.notif ? ctx->prof_wake : coop_tick_cb()) -
+        ctx->prof_start;
+
+    ent->waits++;
+    if (!ctx->wait_flgs.notif) ent->timeouts++;
+    ent->total += blocked;
+    if (ent->max < blocked) ent->max = blocked;
+}
+
+/**
+ * Account notification with no waiter.
+ */
+static void _prof_lost(int sem_id, const void *obj)
+{
+    register coop_prof_stats_t *ent = _prof_entry(sem_id, obj);
+    if (ent) ent->lost++;
+}
+#endif /* CONFIG_OPT_PROF */
+
+#ifdef CONFIG_OPT_STATS
+# ifdef __unix__
+/* statistics may be read by other processes running on other CPUs */
+#  define _MEM_BARRIER() __sync_synchronize()
+# else
+#  define _MEM_BARRIER() __asm__ __volatile__("" ::: "memory")
+# endif
+
+/**
+ * Map thread @c i state to its exported counterpart.
+ */
+static uint8_t _stats_state(unsigned i)
+{
+    switch (sched.thrds[i].state)
+    {
+# ifndef CONFIG_NOEXIT_STATIC_THREADS
+    case HOLE:
+        return COOP_STATS_HOLE;
+# endif
+    case NEW:
+        return COOP_STATS_NEW;
+    case RUN:
+        return COOP_STATS_RUN;
+# ifdef CONFIG_OPT_IDLE
+    case IDLE:
+        return COOP_STATS_IDLE;
+# endif
+# ifdef CONFIG_OPT_WAIT
+    case WAIT:
+        return COOP_STATS_WAIT;
+# endif
+    default:
+        return COOP_STATS_EMPTY;
+    }
+}
+
+/**
+ * Store statistics of thread @c i in the export buffer. Thread name and stack
+ * water-mark (both not changing or costly to calculate on every switch) are
+ * stored if @c full is set.
+ */
+static void _stats_exp_thrd(unsigned i, bool full)
+{
+    register coop_stats_exp_thrd_t *exp = &sched.stats_exp->thrds[i];
+    register const coop_thrd_ctx_t *ctx = &sched.thrds[i];
+
+    if (ctx->state == EMPTY) {
+        memset(exp, 0, sizeof(*exp));
+        return;
+    }
+
+    if (full) {
+        if (ctx->name) {
+            strncpy(exp->name, ctx->name, sizeof(exp->name) - 1);
+            exp->name[sizeof(exp->name) - 1] = 0;
+        } else {
+            exp->name[0] = 0;
+        }
+    }
+    exp->state = _stats_state(i);
+
+    exp->run_ticks = (uint32_t)ctx->run_ticks;
+    exp->switch_n = (uint32_t)ctx->switch_n;
+# ifdef CONFIG_OPT_WAIT
+    if (_IS_WAIT(ctx->state)) {
+        exp->wait_sem = ctx->sem_id;
+        exp->wait_obj = (uint64_t)(uintptr_t)_wait_obj(i);
+    } else {
+        exp->wait_sem = 0;
+        exp->wait_obj = 0;
+    }
+# endif
+# ifdef __COOP_MEM_STATS
+    exp->mem_cur = ctx->mem_cur;
+    exp->mem_peak = ctx->mem_peak;
+# endif
+# ifdef CONFIG_OPT_STACK_WM
+    if (full) exp->stack_wm = (uint32_t)_stack_wm(i);
+# elif defined(CONFIG_OPT_STACK_WM_SP)
+    /* cheap to calculate; updated regardless of @c full */
+    exp->stack_wm = (uint32_t)_stack_wm_sp(i);
+# endif
+}
+
+/**
+ * Update the statistics export buffer. Statistics of thread @c thrd are
+ * updated or the whole threads table is refreshed if @c thrd is
+ * @c CONFIG_MAX_THREADS. If @c full is not set, the update is a light one
+ * done on a thread switch: the thread name is not stored and the update tick
+ * is the one sampled by the switch.
+ */
+static void _stats_export(unsigned thrd, bool full)
+{
+    register coop_stats_exp_t *exp = sched.stats_exp;
+    register unsigned i;
+
+    if (!exp) return;
+
+    /* sequence lock; odd while updating */
+    exp->seq++;
+    _MEM_BARRIER();
+
+    if (thrd < CONFIG_MAX_THREADS) {
+        _stats_exp_thrd(thrd, full);
+    } else {
+        for (i = 0; i < CONFIG_MAX_THREADS; i++) {
+            _stats_exp_thrd(i, true);
+        }
+    }
+    exp->tick = (uint32_t)(full ? coop_tick_cb() : sched.switch_tick);
+    exp->switch_n = (uint32_t)sched.switch_n;
+    exp->idle_n = (uint32_t)sched.idle_n_cb;
+    exp->busy_n = sched.busy_n;
+
+    _MEM_BARRIER();
+    exp->seq++;
+}
+
+/**
+ * Update the export buffer after the current thread switched back to the
+ * scheduler.
+ */
+static inline void _stats_export_switch(void)
+{
+    if (sched.stats_exp && sched.cur_thrd < CONFIG_MAX_THREADS)
+    {
+        /* the whole table is refreshed on a thread termination,
+           since other threads stacks might have been unwinded */
+        _stats_export(sched.thrds[sched.cur_thrd].state == EMPTY
+# ifndef CONFIG_NOEXIT_STATIC_THREADS
+            || sched.thrds[sched.cur_thrd].state == HOLE
+# endif
+            ? CONFIG_MAX_THREADS : sched.cur_thrd, false);
+    }
+}
+#endif /* CONFIG_OPT_STATS */
+
+#ifdef CONFIG_OPT_WAIT
+/**
+ * Prepare the current thread for switching into the waiting state.
+ */
+static inline void _wait_prep(coop_period_t timeout)
+{
+    sched.thrds[sched.cur_thrd].wait_flgs.notif = 0;
+# ifdef CONFIG_OPT_PROF
+    sched.thrds[sched.cur_thrd].prof_start = coop_tick_cb();
+# endif
+    if (timeout) {
+        sched.thrds[sched.cur_thrd].wait_to = _CUR_TICK() + timeout;
+        sched.thrds[sched.cur_thrd].wait_flgs.inf = 0;
+    } else {
+        sched.thrds[sched.cur_thrd].wait_to = 0;
+        sched.thrds[sched.cur_thrd].wait_flgs.inf = 1;
+    }
+# ifdef CONFIG_OPT_IDLE
+    sched.idle_n++;
+# endif
+}
+
+/**
+ * Switch waiting thread @c i into running state as notified.
+ */
+static inline void _wait_wakeup(unsigned i)
+{
+    sched.thrds[i].wait_flgs.notif = 1;
+# ifdef CONFIG_OPT_PROF
+    sched.thrds[i].prof_wake = coop_tick_cb();
+# endif
+    sched.thrds[i].state = RUN;
+# ifdef CONFIG_OPT_IDLE
+    sched.idle_n--;
+# endif
+}
+#endif /* CONFIG_OPT_WAIT */
+
+#ifdef CONFIG_OPT_RING
+# define _RING_EMPTY(_ring) ((_ring)->head == (_ring)->tail)
+
+/* thread @c _i of scheduler @c _s is waiting on a ring buffer with pending
+   data */
+# define _IS_RING_READY_S(_s, _i) ((_s).thrds[_i].wait_flgs.ring && \
+    !_RING_EMPTY((coop_ring_t*)(_s).thrds[_i].cv))
+# define _IS_RING_READY(_i) _IS_RING_READY_S(sched, _i)
+#endif
+
+#ifdef CONFIG_OPT_WAIT_POLL
+/* thread @c _i of scheduler @c _s is waiting on a poll-predicate which is
+   satisfied */
+# define _IS_POLL_READY_S(_s, _i) ((_s).thrds[_i].wait_flgs.poll && \
+    (_s).thrds[_i].predic((_s).thrds[_i].cv))
+# define _IS_POLL_READY(_i) _IS_POLL_READY_S(sched, _i)
+#endif
+
+/*
+ * NOTE: to reduce stack usage by coop_sched_service() helper routines, these
+ * are defined as inline with all their local variables stored in registers.
+ */
+
+#ifndef CONFIG_NOEXIT_STATIC_THREADS
+/**
+ * Mark threads whose stacks need to be unwinded.
+ *
+ * Return terminated thread index at which the unwinded stack shall finish.
+ * The new scheduler stack frame will be set at the thread context after the
+ * unwinding process completes.
+ */
+static inline unsigned _mark_unwind_thrds()
+{
+    register unsigned i, depth, unwnd_thrd = sched.cur_thrd;
+
+    /* mark the terminating (most shallow) thread as EMPTY */
+    coop_dbg_log_cb("Thread #%d: RUN -> EMPTY\n", sched.cur_thrd);
+    sched.thrds[sched.cur_thrd].state = EMPTY;
+    sched.busy_n--;
+
+    /* calculate current main stack depth */
+    for (i = depth = 0; i < CONFIG_MAX_THREADS; i++) {
+        if (_IS_STARTED(sched.thrds[i].state)) {
+            if (depth < sched.thrds[i].depth)
+                depth = sched.thrds[i].depth;
+        }
+    }
+
+    if (depth + 1 < sched.depth)
+    {
+        /*
+         * All holes between the terminating thread and the most shallow
+         * started thread are marked as EMPTY to indicate stack space occupied
+         * by these threads stacks as to be freed.
+         */
+        for (i = 0; i < CONFIG_MAX_THREADS; i++) {
+            if (sched.thrds[i].state == HOLE) {
+                if (depth + 1 <= sched.thrds[i].depth)
+                {
+                    if (depth + 1 == sched.thrds[i].depth) {
+                        unwnd_thrd = i;
+                    }
+                    coop_dbg_log_cb("Thread #%d: HOLE -> EMPTY\n", i);
+                    sched.thrds[i].state = EMPTY;
+                    sched.busy_n--;
+                    sched.hole_n--;
+                }
+            }
+        }
+    } else {
+        /*
+         * No hole between the most shallow started thread and the terminating
+         * thread. Unwinded stack will be set to the terminating thread stack.
+         */
+    }
+    sched.depth = depth;
+
+    return unwnd_thrd;
+}
+#endif
+
+#ifdef CONFIG_OPT_RCU
+/**
+ * Call queued RCU callbacks. To be called at the scheduler switch point.
+ */
+static inline void _rcu_callbacks(void)
+{
+    register coop_rcu_head_t *head;
+
+    while ((head = sched.rcu_head) != NULL)
+    {
+        /* callbacks queued by the callbacks are called in the same pass */
+        sched.rcu_head = head->next;
+        if (!sched.rcu_head) sched.rcu_tail = NULL;
+
+        coop_dbg_log_cb("RCU callback %p\n", (void*)head);
+        head->func(head);
+    }
+}
+#endif
+
+#ifdef CONFIG_OPT_NESTED_SCHED
+/**
+ * Child scheduler: pass control to the parent scheduler by yielding the host
+ * thread.
+ */
+static void _host_yield(void)
+{
+    coop_sched_ctx_t *child = cur_sched;
+
+    cur_sched = child->parent;
+    coop_yield();
+    cur_sched = child;
+}
+
+# ifdef CONFIG_OPT_IDLE
+/**
+ * Poll-predicate of the host thread waiting in the parent scheduler: a thread
+ * of the idle child scheduler @c cv has been notified (by other scheduler
+ * thread or ISR), woken-up by a ring data or its poll-predicate (possibly of
+ * a host thread of a next nesting level).
+ */
+static bool _child_ready(void *cv)
+{
+    coop_sched_ctx_t *child = (coop_sched_ctx_t*)cv;
+    unsigned i;
+
+    for (i = 0; i < CONFIG_MAX_THREADS; i++)
+    {
+        if (child->thrds[i].state == RUN) return true;
+
+        if (_IS_WAIT(child->thrds[i].state) && (
+#  ifdef CONFIG_OPT_RING
+            _IS_RING_READY_S(*child, i) ||
+#  endif
+            _IS_POLL_READY_S(*child, i)))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Child scheduler: all its threads are idle or waiting. The host thread waits
+ * in the parent scheduler up to the nearest child wake-up time (@c period;
+ * infinitely if 0) or a child thread is woken-up, so the parent scheduler is
+ * able to enter the system idle state.
+ */
+static void _host_idle(coop_tick_t period)
+{
+    coop_sched_ctx_t *child = cur_sched;
+
+    cur_sched = child->parent;
+    coop_wait_poll(_child_ready, child, (coop_period_t)period);
+    cur_sched = child;
+}
+# endif
+#endif
+
+#ifdef CONFIG_OPT_IDLE
+/**
+ * Check conditions and enter the system idle state if necessary.
+ */
+static inline void _system_idle(void)
+{
+    register unsigned i = 0;
+    register coop_deadline_t min_idle = 0, cur_tick = 0;
+
+    /* system is considered idle-ready if all active threads are idle or waiting */
+    while (sched.idle_n > 0 && _ACTIVE_THREADS() <= sched.idle_n)
+    {
+# ifdef CONFIG_OPT_REMOTE_SPAWN
+        if (i) {
+            /* threads spawned while idle finish the idle-loop */
+            _spawn_drain();
+            if (_ACTIVE_THREADS() > sched.idle_n) break;
+        }
+# endif
+        if (i) {
+            /* min_idle was set in the previous loop pass */
+            register coop_tick_t period = (min_idle == _MAX_DEADLINE ? 0 :
+# ifdef CONFIG_OPT_EXT_TICK
+                /* longer periods span several idle-loop passes */
+                min_idle > COOP_MAX_PERIOD ? COOP_MAX_PERIOD :
+# endif
+                (coop_tick_t)min_idle);
+# ifdef COOP_DEBUG
+            if (!period) {
+                coop_dbg_log_cb("System going idle infinitely\n");
+            } else {
+                coop_dbg_log_cb("System going idle for %lu ticks\n",
+                    (unsigned long)period);
+            }
+# endif
+# ifdef CONFIG_OPT_RING
+            /* no idle if ring data has been put since last check */
+            if (!ring_pend)
+# endif
+# ifdef CONFIG_OPT_IDLE_WORK
+            /* deferrable work done in chunks up to nearest wake-up time */
+            if (!sched.idle_work ||
+                !sched.idle_work(period, sched.idle_work_arg))
+# endif
+            {
+# ifdef CONFIG_OPT_STATS
+                sched.idle_n_cb++;
+                _stats_export(CONFIG_MAX_THREADS, true);
+# endif
+# ifdef CONFIG_OPT_NESTED_SCHED
+                if (sched.parent) {
+                    /* host thread waits up to nearest wake-up time */
+                    _host_idle(period);
+                } else
+# endif
+                /* system is idle up to nearest wake-up time */
+                coop_idle_cb(period);
+            }
+        }
+
+        min_idle = _MAX_DEADLINE;
+        cur_tick = _CUR_TICK();     /* current tick */
+# ifdef CONFIG_OPT_RING
+        ring_pend = false;
+# endif
+
+        for (i = 0; i < CONFIG_MAX_THREADS; i++)
+        {
+# ifdef CONFIG_OPT_RING
+            if (_IS_WAIT(sched.thrds[i].state) && _IS_RING_READY(i)) {
+                coop_dbg_log_cb("Thread #%d WAIT -> RUN (ring data; "
+                    "via idle-loop)\n", i);
+
+                /* ring data pending; the idle-loop will be finished */
+                _wait_wakeup(i);
+                continue;
+            }
+# endif
+# ifdef CONFIG_OPT_WAIT_POLL
+            if (_IS_WAIT(sched.thrds[i].state) && _IS_POLL_READY(i)) {
+                coop_dbg_log_cb("Thread #%d WAIT -> RUN (poll-predicate; "
+                    "via idle-loop)\n", i);
+
+                /* poll-predicate satisfied; the idle-loop will be finished */
+                _wait_wakeup(i);
+                continue;
+            }
+# endif
+
+            if (_IS_IDLE(sched.thrds[i].state)
+# ifdef CONFIG_OPT_WAIT
+                || (_IS_WAIT(sched.thrds[i].state) &&
+                    !sched.thrds[i].wait_flgs.inf)
+# endif
+                )
+            {
+                register coop_deadline_t idle_to = (
+# ifdef CONFIG_OPT_WAIT
+                    !_IS_IDLE(sched.thrds[i].state) ? sched.thrds[i].wait_to :
+# endif
+                    sched.thrds[i].idle_to);
+
+                if (_IS_DUE(cur_tick, idle_to)) {
+                    coop_dbg_log_cb("Thread #%d %s -> RUN (via idle-loop)\n",
+                        i, _state_name(i));
+
+                    /* idle time passed; the idle-loop will be finished */
+                    sched.thrds[i].state = RUN;
+                    sched.idle_n--;
+                } else
+                if ((idle_to - cur_tick) < min_idle) {
+                    /* calculate nearest wake-up time */
+                    min_idle = (idle_to - cur_tick);
+                }
+            }
+        }
+    }
+}
+#endif /* CONFIG_OPT_IDLE */
+
+void coop_sched_service(void)
+{
+    while (sched.busy_n > 0)
+    {
+#ifdef CONFIG_OPT_STATS
+        /* thread switched back to the scheduler */
+        _stats_export_switch();
+#endif
+#ifdef CONFIG_OPT_REMOTE_SPAWN
+        _spawn_drain();
+#endif
+#ifdef CONFIG_OPT_STACK_LEARN
+        _stack_learn_flush();
+#endif
+#ifdef CONFIG_OPT_RCU
+        /* thread switched to the scheduler; RCU grace period elapsed */
+        _rcu_callbacks();
+#endif
+#ifdef CONFIG_OPT_IDLE
+        /*
+         * The routine is called if currently handled thread passed through
+         * NEW or RUN states, therefore circumstances which could switch the
+         * thread to idle or waiting states may occur and checking conditions
+         * for suspending the platform should be performed. In other cases
+         * (EMPTY, HOLE and IDLE/WAIT states with the idle/waiting state
+         * still pending) the control passes through 'next_iter' label. This
+         * eliminates unnecessary checks in _system_idle() and increases
+         * performance of the scheduler service.
+         */
+        _system_idle();
+#endif
+        /*
+         * coop_sched_service() routine is called recursively during building
+         * stack frames for newly created threads. Each time the recursion
+         * occurs the cur_thrd index need to be updated for the next thread to
+         * process. For this reason the incrementation takes place at the loop
+         * entry stage.
+         */
+next_iter:
+        sched.cur_thrd = (sched.cur_thrd + 1) % CONFIG_MAX_THREADS;
+
+#ifdef CONFIG_OPT_NESTED_SCHED
+        if (!sched.cur_thrd && sched.parent) {
+            /* child threads pool round finished; let the parent run */
+            _host_yield();
+        }
+#endif
+
+        switch (sched.thrds[sched.cur_thrd].state)
+        {
+        case EMPTY:
+#ifndef CONFIG_NOEXIT_STATIC_THREADS
+        case HOLE:
+#endif
+        default:
+            goto next_iter;
+
+#ifdef CONFIG_OPT_IDLE
+        case IDLE:
+            if (!_IS_DUE(_CUR_TICK(), sched.thrds[sched.cur_thrd].idle_to))
+            {
+                /* the current thread is idle but other threads are running;
+                   system can't switch to the idle state in this case */
+                goto next_iter;
+            }
+
+            /* idle time passed; continue as in RUN state  */
+            coop_dbg_log_cb("Thread #%d IDLE -> RUN (via sched-loop)\n",
+                sched.cur_thrd);
+            sched.thrds[sched.cur_thrd].state = RUN;
+            sched.idle_n--;
+            goto run;
+#endif
+
+#ifdef CONFIG_OPT_WAIT
+        case WAIT:
+# ifdef CONFIG_OPT_RING
+            if (_IS_RING_READY(sched.cur_thrd)) {
+                coop_dbg_log_cb("Thread #%d WAIT -> RUN (ring data)\n",
+                    sched.cur_thrd);
+
+                /* ring data pending; continue as in RUN state */
+                _wait_wakeup(sched.cur_thrd);
+                goto run;
+            }
+# endif
+# ifdef CONFIG_OPT_WAIT_POLL
+            if (_IS_POLL_READY(sched.cur_thrd)) {
+                coop_dbg_log_cb("Thread #%d WAIT -> RUN (poll-predicate)\n",
+                    sched.cur_thrd);
+
+                /* poll-predicate satisfied; continue as in RUN state */
+                _wait_wakeup(sched.cur_thrd);
+                goto run;
+            }
+# endif
+            if (sched.thrds[sched.cur_thrd].wait_flgs.inf ||
+                !_IS_DUE(_CUR_TICK(), sched.thrds[sched.cur_thrd].wait_to))
+            {
+                /* not-notified infinite or not yet timed-out waiting thread */
+                goto next_iter;
+            }
+
+            coop_dbg_log_cb(
+                "Thread #%d WAIT -> RUN (timed-out)\n", sched.cur_thrd);
+
+            /* wait time passed; continue as in RUN state  */
+            sched.thrds[sched.cur_thrd].state = RUN;
+# ifdef CONFIG_OPT_IDLE
+            sched.idle_n--;
+# endif
+            goto run;
+#endif
+
+        case RUN:
+#if defined(CONFIG_OPT_IDLE) || defined(CONFIG_OPT_WAIT)
+run:
+#endif
+            /* sched_pos_run: main-running scheduler execution context */
+            if (!setjmp(sched.exe_ctx))
+            {
+                coop_dbg_log_cb("setjmp sched_pos_run; run thread #%d: "
+                    "longjmp thrd_pos_[new/run]\n", sched.cur_thrd);
+
+#ifdef CONFIG_OPT_YIELD_AFTER
+                sched.thrds[sched.cur_thrd].switch_tick = coop_tick_cb();
+#endif
+                _switch_in();
+
+                /* jump to running thread: thrd_pos_new, thrd_pos_run */
+                longjmp(sched.thrds[sched.cur_thrd].exe_ctx, 1);
+            } else {
+                /* return from yielded running thread or restore
+                   scheduler stack after thread terminated as a hole */
+                coop_dbg_log_cb("Back to scheduler from #%d thread\n",
+                    sched.cur_thrd);
+            }
+            break;
+
+        case NEW:
+#ifdef CONFIG_NOEXIT_STATIC_THREADS
+            coop_dbg_log_cb("New thread #%d\n", sched.cur_thrd);
+
+# ifdef CONFIG_OPT_YIELD_AFTER
+            sched.thrds[sched.cur_thrd].switch_tick = coop_tick_cb();
+# endif
+            /* enter the thread routine */
+            _switch_in();
+            sched.thrds[sched.cur_thrd].proc(sched.thrds[sched.cur_thrd].arg);
+            _switch_out();
+# ifdef CONFIG_OPT_STACK_LEARN
+            _stack_learn_term(sched.cur_thrd);
+# endif
+
+            /* thread configured with CONFIG_NOEXIT_STATIC_THREADS
+               is not expected to finish */
+            coop_dbg_log_cb("UNEXPECTED: Thread #%d: RUN -> EMPTY\n",
+                sched.cur_thrd);
+            sched.thrds[sched.cur_thrd].state = EMPTY;
+            sched.busy_n--;
+            break;
+#else
+            /* sched_pos_entry_thrd: save a new thread entry stack state */
+            if (!setjmp(sched.thrds[sched.cur_thrd].entry_ctx))
+            {
+                coop_dbg_log_cb("setjmp sched_pos_entry_thrd; new thread #%d\n",
+                    sched.cur_thrd);
+
+                sched.depth++;
+                sched.thrds[sched.cur_thrd].depth = sched.depth;
+
+# ifdef CONFIG_OPT_YIELD_AFTER
+                sched.thrds[sched.cur_thrd].switch_tick = coop_tick_cb();
+# endif
+                /* enter the thread routine */
+                _switch_in();
+                sched.thrds[sched.cur_thrd].proc(sched.thrds[sched.cur_thrd].arg);
+                _switch_out();
+# ifdef CONFIG_OPT_STACK_LEARN
+                _stack_learn_term(sched.cur_thrd);
+# endif
+
+                /*
+                 * At this point the current thread is being terminated.
+                 * Scheduler stack is set at the thread stack frame, therefore
+                 * need to be updated:
+                 *
+                 * - If the terminating thread stack depth is less than the
+                 *   number of threads stacks occupying the main stack, the
+                 *   thread constitutes a hole (a terminated thread with its
+                 *   stack still occupying the main stack space). In this case
+                 *   the scheduler stack frame is restored to its previous
+                 *   position. No stack unwind occurs.
+                 *
+                 * - If the terminating thread stack depth is equal to the
+                 *   number of threads stacks occupying the main stack - the
+                 *   stack unwind occurs. In this case the scheduler stack
+                 *   frame is set to the position of an already terminated
+                 *   thread stack frame (possibly a hole) just above a started
+                 *   thread with most shallow stack.
+                 */
+                if (sched.thrds[sched.cur_thrd].depth < sched.depth)
+                {
+                    coop_dbg_log_cb("Thread #%d: RUN -> HOLE; "
+                        "scheduler stack-restore: longjmp sched_pos_run\n",
+                        sched.cur_thrd);
+
+                    sched.thrds[sched.cur_thrd].state = HOLE;
+                    sched.hole_n++;
+
+                    /* restore previous scheduler stack frame; sched_pos_run jump */
+                    longjmp(sched.exe_ctx, 1);
+                } else
+                {
+                    register unsigned unwnd_thrd = _mark_unwind_thrds();
+
+                    coop_dbg_log_cb("Unwind scheduler stack at #%d thread entry "
+                        "context: longjmp sched_pos_entry_thrd\n", unwnd_thrd);
+
+                    /* unwind scheduler stack; sched_pos_entry_thrd jump */
+                    longjmp(sched.thrds[unwnd_thrd].entry_ctx, 1);
+                }
+            } else {
+                /* return with unwinded stack; new scheduler stack frame
+                   from this point */
+                coop_dbg_log_cb("Back to scheduler; stack unwinded\n");
+            }
+            break;
+#endif /* CONFIG_NOEXIT_STATIC_THREADS */
+        }
+    }
+
+#ifdef CONFIG_OPT_RCU
+    /* callbacks queued by the last terminated thread */
+    _rcu_callbacks();
+#endif
+#ifdef CONFIG_OPT_STACK_LEARN
+    /* the last terminated thread */
+    _stack_learn_flush();
+#endif
+
+#ifdef CONFIG_NOEXIT_STATIC_THREADS
+    /*
+     * Can't exit the routine since stack has not been unwinded
+     * up to its entry point. Assertion will fire in this case.
+     */
+    coop_dbg_log_cb("UNEXPECTED: coop_sched_service() exits!\n");
+    assert(false);
+#else
+    _sched_init(true);
+# ifdef CONFIG_OPT_STATS
+    _stats_export(CONFIG_MAX_THREADS, true);
+# endif
+#endif
+}
+
+coop_error_t coop_sched_thread(coop_thrd_proc_t proc, const char *name,
+    size_t stack_sz, void *arg)
+{
+#ifdef __COOP_MEM_STATS
+    /* generations are unique across schedulers and their sessions */
+    static unsigned mem_gen = 0;
+#endif
+
+    if (!proc) {
+        return COOP_ERR_INV_ARG;
+    } else
+    if (sched.busy_n >= CONFIG_MAX_THREADS) {
+        return COOP_ERR_LIMIT;
+    }
+
+#ifdef CONFIG_OPT_STACK_LEARN
+    if (!stack_sz && name) {
+        /* use learned stack size if known */
+        stack_sz = coop_stack_learn_load_cb(name);
+        if (stack_sz) stack_sz += CONFIG_STACK_LEARN_MARGIN;
+    }
+#endif
+    _sched_init(false);
+
+    for (unsigned i = 0; i < CONFIG_MAX_THREADS; i++) {
+        if (sched.thrds[i].state == EMPTY)
+        {
+            sched.thrds[i].proc = proc;
+            sched.thrds[i].name = name;
+            sched.thrds[i].stack = NULL;
+            sched.thrds[i].stack_sz =
+                (!stack_sz ? CONFIG_DEFAULT_STACK_SIZE : stack_sz);
+            sched.thrds[i].arg = arg;
+            sched.thrds[i].state = NEW;
+#ifdef __COOP_MEM_STATS
+            /* memory blocks of previous slot occupants are not credited */
+            if (!++mem_gen) mem_gen++;
+            sched.thrds[i].mem_gen = mem_gen;
+            sched.thrds[i].mem_cur = sched.thrds[i].mem_peak =
+                sched.thrds[i].mem_total = sched.thrds[i].mem_limit = 0;
+#endif
+#ifdef CONFIG_OPT_STATS
+            sched.thrds[i].run_ticks = 0;
+            sched.thrds[i].switch_n = 0;
+#endif
+#ifdef CONFIG_OPT_STACK_WM_SP
+            sched.thrds[i].sp_wm = NULL;
+#endif
+#ifdef CONFIG_OPT_STACK_CANARY
+            sched.thrds[i].canary = NULL;
+#endif
+#ifndef CONFIG_NOEXIT_STATIC_THREADS
+            sched.thrds[i].depth = 0;
+            memset(sched.thrds[i].entry_ctx, 0, sizeof(sched.thrds[i].entry_ctx));
+#endif
+            memset(sched.thrds[i].exe_ctx, 0, sizeof(sched.thrds[i].exe_ctx));
+
+            sched.busy_n++;
+#ifdef CONFIG_OPT_STATS
+            _stats_export(i, true);
+#endif
+            coop_dbg_log_cb("Thread #%d scheduled to run\n", i);
+            break;
+        }
+    }
+    return COOP_SUCCESS;
+}
+
+#ifdef CONFIG_OPT_NESTED_SCHED
+coop_error_t coop_sched_nested(coop_thrd_proc_t proc, const char *name,
+    size_t stack_sz, void *arg)
+{
+    /* child scheduler context is placed on the host thread stack */
+    coop_sched_ctx_t child;
+    coop_sched_ctx_t *parent = cur_sched, *prev;
+    coop_error_t ret;
+
+    if (!sched.in_thrd) {
+        return COOP_ERR_INV_ARG;
+    }
+
+    memset(&child, 0, sizeof(child));
+    child.cur_thrd = (unsigned)-1;
+    child.parent = parent;
+    child.next = root_sched.next;
+    root_sched.next = &child;
+
+    coop_dbg_log_cb("Thread #%d enters child scheduler\n", sched.cur_thrd);
+
+    cur_sched = &child;
+    if ((ret = coop_sched_thread(proc, name, stack_sz, arg)) == COOP_SUCCESS) {
+        coop_sched_service();
+    }
+    /* the child context is zeroed at the service exit */
+    cur_sched = parent;
+
+    for (prev = &root_sched; prev->next != &child; prev = prev->next);
+    prev->next = child.next;
+
+    coop_dbg_log_cb("Thread #%d leaves child scheduler\n", sched.cur_thrd);
+    return ret;
+}
+#endif
+
+#ifdef CONFIG_OPT_REMOTE_SPAWN
+coop_error_t coop_spawn_remote(coop_thrd_proc_t proc, const char *name,
+    size_t stack_sz, void *arg)
+{
+    coop_spawn_cell_t *cell;
+    unsigned pos, k;
+    int diff;
+
+    if (!proc) {
+        return COOP_ERR_INV_ARG;
+    }
+
+    pos = __atomic_load_n(&spawn_q.enq_pos, __ATOMIC_RELAXED);
+    for (;;)
+    {
+        k = _SPAWN_CELL_IDX(pos);
+        cell = &spawn_q.cells[k];
+        diff = (int)(__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) + k - pos);
+
+        if (!diff) {
+            /* free cell; claim the position (pos updated on failure) */
+            if (__atomic_compare_exchange_n(&spawn_q.enq_pos, &pos, pos + 1,
+                true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) break;
+        } else
+        if (diff < 0) {
+            /* the cell is still occupied by the previous queue cycle */
+            return COOP_ERR_LIMIT;
+        } else {
+            /* the position claimed by other producer */
+            pos = __atomic_load_n(&spawn_q.enq_pos, __ATOMIC_RELAXED);
+        }
+    }
+
+    cell->proc = proc;
+    cell->name = name;
+    cell->stack_sz = stack_sz;
+    cell->arg = arg;
+
+    /* publish the request */
+    __atomic_store_n(&cell->seq, pos + 1 - k, __ATOMIC_RELEASE);
+
+    coop_idle_wakeup_cb();
+    return COOP_SUCCESS;
+}
+#endif /* CONFIG_OPT_REMOTE_SPAWN */
+
+const char *coop_thread_name(void)
+{
+    return sched.thrds[sched.cur_thrd].name;
+}
+
+bool coop_in_thread(void)
+{
+    return sched.in_thrd;
+}
+
+/**
+ * @c new_state specifies a state to set before yielding (RUN, IDLE, WAIT).
+ */
+static inline void _yield(coop_thrd_state_t new_state)
+{
+#ifdef __COOP_STACK_DIR
+    unsigned char sp;
+#endif
+#ifdef CONFIG_OPT_STACK_WM_SP
+    _stack_sample(&sp);
+#endif
+    /* switched back in by the scheduler */
+    _switch_out();
+
+    if (sched.thrds[sched.cur_thrd].state == NEW) {
+        sched.thrds[sched.cur_thrd].state = new_state;
+
+        /* thrd_pos_new: newly created thread context */
+        if (!setjmp(sched.thrds[sched.cur_thrd].exe_ctx))
+        {
+            coop_dbg_log_cb("setjmp thrd_pos_new; thread #%d: NEW -> %s\n",
+                sched.cur_thrd, _state_name(sched.cur_thrd));
+
+            /* allocate thread stack */
+            /*
+             * NOTE: For performance reason the allocation takes place after
+             * the call to the thread routine while the routine yields its
+             * control to the scheduler for the first time (there is no point
+             * to allocate thread's stack for a routine which simply enters and
+             * immediately exists without yielding to the scheduler, since the
+             * stack would not be used in such case).
+             * For this reason the stack used by the thread is (in most cases)
+             * larger than the size indicated by its requested value. This extra
+             * space is the one which has already been allocated while entering
+             * the thread routine for the first time (so embracing all or part
+             * of its local variables created on the stack new frame).
+             * This approach has this benefit, a library user needs not to take
+             * care about thread local variables size calculation occupying its
+             * stack, since by moving them to the routine's main scope they will
+             * be allocated on the thread stack frame while entering the routine.
+             * Library user's requested stack size must in this case embrace
+             * stack space which is used dynamically by the thread during its
+             * lifetime (including preemptive ISRs).
+             */
+#ifndef CONFIG_OPT_STACK_CANARY
+            sched.thrds[sched.cur_thrd].stack =
+                alloca(sched.thrds[sched.cur_thrd].stack_sz);
+#else
+            /* extra space for the canary word */
+            sched.thrds[sched.cur_thrd].stack = alloca(
+                _CANARY_ALIGN(sched.thrds[sched.cur_thrd].stack_sz) +
+                sizeof(unsigned));
+#endif
+#ifdef __COOP_STACK_DIR
+            /*
+             * The stack is allocated beyond the current frame, therefore its
+             * position indicates the stack growth direction.
+             */
+            sched.stack_down =
+                ((unsigned char*)sched.thrds[sched.cur_thrd].stack < &sp);
+#endif
+#ifdef CONFIG_OPT_STACK_CANARY
+            /* canary word is placed just beyond the stack far end */
+            if (sched.stack_down) {
+                sched.thrds[sched.cur_thrd].canary =
+                    (unsigned*)sched.thrds[sched.cur_thrd].stack;
+                sched.thrds[sched.cur_thrd].stack =
+                    sched.thrds[sched.cur_thrd].canary + 1;
+            } else {
+                sched.thrds[sched.cur_thrd].canary = (unsigned*)(
+                    (unsigned char*)sched.thrds[sched.cur_thrd].stack +
+                    _CANARY_ALIGN(sched.thrds[sched.cur_thrd].stack_sz));
+            }
+            *sched.thrds[sched.cur_thrd].canary = STACK_CANARY;
+#endif
+#ifdef CONFIG_OPT_STACK_WM
+            /* padding is needed by the water-mark scan only */
+            memset(sched.thrds[sched.cur_thrd].stack, STACK_PADD,
+                sched.thrds[sched.cur_thrd].stack_sz);
+#endif
+#ifdef CONFIG_OPT_STACK_WM_SP
+            /* water-mark starts at the stack boundary adjacent to the
+               current frame */
+            sched.thrds[sched.cur_thrd].sp_wm = (sched.stack_down ?
+                (unsigned char*)sched.thrds[sched.cur_thrd].stack +
+                    sched.thrds[sched.cur_thrd].stack_sz :
+                (unsigned char*)sched.thrds[sched.cur_thrd].stack);
+#endif
+
+            /* build new thread stack via recurrent scheduler service call */
+            coop_sched_service();
+        } else {
+            /* return from scheduler; first run */
+            coop_dbg_log_cb("Back to #%d thread (via thrd_pos_new)\n",
+                sched.cur_thrd);
+        }
+    } else {
+        sched.thrds[sched.cur_thrd].state = new_state;
+#ifdef COOP_DEBUG
+        if (new_state != RUN) {
+            coop_dbg_log_cb("Thread #%d: RUN -> %s\n",
+                sched.cur_thrd, _state_name(sched.cur_thrd));
+        }
+#endif
+
+        /* thrd_pos_run: main-running thread context */
+        if (!setjmp(sched.thrds[sched.cur_thrd].exe_ctx))
+        {
+            coop_dbg_log_cb("setjmp thrd_pos_run; back from #%d thread to "
+                "scheduler: longjmp sched_pos_run\n", sched.cur_thrd);
+
+            /* back to scheduler: sched_pos_run jump */
+            longjmp(sched.exe_ctx, 1);
+        } else {
+            /* return from scheduler; regular run */
+            coop_dbg_log_cb("Back to #%d thread (via thrd_pos_run)\n",
+                sched.cur_thrd);
+        }
+    }
+#ifdef CONFIG_OPT_PROF
+    if (new_state == WAIT) _prof_wait_end();
+#endif
+}
+
+#ifdef CONFIG_OPT_IDLE
+void coop_idle(coop_period_t period)
+{
+    coop_thrd_state_t new_state = RUN;
+
+    if (period > 0) {
+        coop_dbg_log_cb("Thread #%d going idle for %lu ticks\n",
+            sched.cur_thrd, (unsigned long)period);
+
+        new_state = IDLE;
+        sched.idle_n++;
+        sched.thrds[sched.cur_thrd].idle_to = _CUR_TICK() + period;
+    }
+    _yield(new_state);
+}
+#else
+void coop_yield(void)
+{
+    _yield(RUN);
+}
+#endif
+
+#ifdef CONFIG_OPT_IDLE_WORK
+void coop_idle_work(coop_idle_work_proc_t proc, void *arg)
+{
+    _sched_init(false);
+
+    sched.idle_work = proc;
+    sched.idle_work_arg = arg;
+}
+#endif
+
+#ifdef CONFIG_OPT_YIELD_AFTER
+void coop_yield_after(coop_tick_t *after, coop_tick_t period)
+{
+    if (COOP_IS_TICK_OVER(coop_tick_cb(), *after))
+    {
+        coop_dbg_log_cb("Thread #%d yields after %lu tick\n",
+            sched.cur_thrd, (unsigned long)*after);
+
+        _yield(RUN);
+        *after = coop_tick_cb() + period;
+    }
+}
+#endif
+
+#ifdef CONFIG_OPT_WAIT
+coop_error_t coop_wait_cond(
+    int sem_id, coop_period_t timeout, coop_predic_proc_t predic, void *cv)
+{
+    sched.thrds[sched.cur_thrd].sem_id = sem_id;
+    sched.thrds[sched.cur_thrd].predic = predic;
+    sched.thrds[sched.cur_thrd].cv = cv;
+    _wait_prep(timeout);
+
+# ifdef COOP_DEBUG
+    if (timeout) {
+        coop_dbg_log_cb("Thread #%d waiting with timeout %lu ticks; "
+            "sem_id: %d\n", sched.cur_thrd, (unsigned long)timeout, sem_id);
+    } else {
+        coop_dbg_log_cb("Thread #%d waiting infinitely; sem_id: %d\n",
+            sched.cur_thrd, sem_id);
+    }
+# endif
+
+    _yield(WAIT);
+
+    if (sched.thrds[sched.cur_thrd].wait_flgs.notif != 0) {
+        coop_dbg_log_cb("Thread #%d notified on sem_id: %d\n",
+            sched.cur_thrd, sem_id);
+        return COOP_SUCCESS;
+    } else {
+        coop_dbg_log_cb("Thread #%d wait-timeout; sem_id: %d\n",
+            sched.cur_thrd, sem_id);
+        return COOP_ERR_TIMEOUT;
+    }
+}
+
+/**
+ * Notify threads of the current scheduler waiting on @c sem_id. Return true
+ * if any thread has been notified.
+ */
+static inline bool _notify_sched(int sem_id, bool single)
+{
+    bool woken = false;
+
+    for (unsigned i = 0; i < CONFIG_MAX_THREADS; i++) {
+        if (_IS_WAIT(sched.thrds[i].state) &&
+# ifdef __COOP_WQ
+            !sched.thrds[i].wait_flgs.wq &&
+# endif
+# ifdef CONFIG_OPT_RING
+            !sched.thrds[i].wait_flgs.ring &&
+# endif
+# ifdef CONFIG_OPT_WAIT_POLL
+            !sched.thrds[i].wait_flgs.poll &&
+# endif
+            sched.thrds[i].sem_id == sem_id &&
+            (!sched.thrds[i].predic || sched.thrds[i].predic(sched.thrds[i].cv)))
+        {
+            coop_dbg_log_cb("Thread #%d WAIT -> RUN (%s-notify on sem_id: %d)\n",
+                i, (single ? "single" : "all"), sem_id);
+
+            _wait_wakeup(i);
+            woken = true;
+            if (single) break;
+        }
+    }
+    return woken;
+}
+
+static inline void _notify(int sem_id, bool single)
+{
+    bool woken = _notify_sched(sem_id, single);
+
+# ifdef CONFIG_OPT_NESTED_SCHED
+    if (!single || !woken) {
+        coop_sched_ctx_t *cur = cur_sched;
+
         /*
-         * The routine is called if currently handled thread passed through
-         * NEW or RUN states, therefore circumstances which could switch the
-         * thread to idle or waiting states may occur and checking conditions
-         * for suspending the platform should be performed. In other cases
-         * (EMPTY, HOLE and IDLE/WAIT states with the idle/waiting state
-         * still pending) the control passes through 'next_iter' label. This
-         * eliminates unnecessary checks in _system_idle() and increases
-         * performance of the scheduler service.
+         * Pass the signal to other schedulers (e.g. sent by ISR while a child
+         * scheduler runs): all of them for notify-all, up to the first
+         * notified thread for single-notify with no local waiter.
          */
-        _system_idle();
-#endif
+        for (cur_sched = &root_sched; cur_sched && !(single && woken);
+            cur_sched = cur_sched->next)
+        {
+            if (cur_sched != cur) woken |= _notify_sched(sem_id, single);
+        }
+        cur_sched = cur;
+    }
+# endif
+# ifdef CONFIG_OPT_PROF
+    if (!woken) _prof_lost(sem_id, NULL);
+# else
+    (void)woken;
+# endif
+}
+
+void coop_notify(int sem_id)
+{
+    _notify(sem_id, true);
+}
+
+void coop_notify_all(int sem_id)
+{
+    _notify(sem_id, false);
+}
+#endif /* CONFIG_OPT_WAIT */
+
+#ifdef CONFIG_OPT_WAIT_POLL
+coop_error_t coop_wait_poll(
+    coop_predic_proc_t predic, void *cv, coop_period_t timeout)
+{
+    if (predic(cv)) {
+        return COOP_SUCCESS;
+    }
+
+    coop_dbg_log_cb("Thread #%d waiting on poll-predicate\n", sched.cur_thrd);
+
+    sched.thrds[sched.cur_thrd].predic = predic;
+    sched.thrds[sched.cur_thrd].cv = cv;
+    sched.thrds[sched.cur_thrd].wait_flgs.poll = 1;
+    _wait_prep(timeout);
+
+    _yield(WAIT);
+
+    sched.thrds[sched.cur_thrd].wait_flgs.poll = 0;
+    if (sched.thrds[sched.cur_thrd].wait_flgs.notif != 0) {
+        return COOP_SUCCESS;
+    } else {
+        coop_dbg_log_cb("Thread #%d poll-predicate wait-timeout\n",
+            sched.cur_thrd);
+        return COOP_ERR_TIMEOUT;
+    }
+}
+#endif /* CONFIG_OPT_WAIT_POLL */
+
+#ifdef __COOP_WQ
+/* thread id <-> thread slot index conversion */
+# define _THRD_ID(_i) ((_i) + 1)
+# define _THRD_IDX(_id) ((_id) - 1)
+
+/**
+ * Remove thread @c i from the wait queue. No-op if the thread is not queued.
+ */
+static void _wq_remove(coop_wq_t *wq, unsigned i)
+{
+    unsigned id, prev = 0;
+
+    for (id = wq->head; id; prev = id, id = sched.thrds[_THRD_IDX(id)].wq_next)
+    {
+        if (id == _THRD_ID(i)) {
+            if (prev) {
+                sched.thrds[_THRD_IDX(prev)].wq_next = sched.thrds[i].wq_next;
+            } else {
+                wq->head = sched.thrds[i].wq_next;
+            }
+            if (wq->tail == id) wq->tail = prev;
+            break;
+        }
+    }
+}
+
+/**
+ * Wait on a wait queue. Current thread is queued at the queue tail and
+ * switched into the waiting state. @c obj is the object (mutex, address)
+ * owning the queue.
+ */
+static coop_error_t _wq_wait(
+    coop_wq_t *wq, const void *obj, coop_period_t timeout)
+{
+    sched.thrds[sched.cur_thrd].wait_flgs.wq = 1;
+    sched.thrds[sched.cur_thrd].wq_next = 0;
+    sched.thrds[sched.cur_thrd].cv = (void*)obj;    /* waiting object */
+    if (wq->tail) {
+        sched.thrds[_THRD_IDX(wq->tail)].wq_next = _THRD_ID(sched.cur_thrd);
+    } else {
+        wq->head = _THRD_ID(sched.cur_thrd);
+    }
+    wq->tail = _THRD_ID(sched.cur_thrd);
+    _wait_prep(timeout);
+
+    coop_dbg_log_cb("Thread #%d waiting on wait-queue %p\n",
+        sched.cur_thrd, (void*)wq);
+
+    _yield(WAIT);
+
+    sched.thrds[sched.cur_thrd].wait_flgs.wq = 0;
+    if (sched.thrds[sched.cur_thrd].wait_flgs.notif != 0) {
+        return COOP_SUCCESS;
+    } else {
+        /* timed-out thread still occupies the queue */
+        _wq_remove(wq, sched.cur_thrd);
+        return COOP_ERR_TIMEOUT;
+    }
+}
+
+/**
+ * Wake-up first thread waiting on a wait queue.
+ *
+ * Return woken thread id or 0 if no thread is waiting on the queue.
+ */
+static inline unsigned _wq_wake(coop_wq_t *wq)
+{
+    unsigned id;
+
+    while ((id = wq->head) != 0)
+    {
+        wq->head = sched.thrds[_THRD_IDX(id)].wq_next;
+        if (!wq->head) wq->tail = 0;
+
         /*
-         * coop_sched_service() routine is called recursively during building
-         * stack frames for newly created threads. Each time the recursion
-         * occurs the cur_thrd index need to be updated for the next thread to
-         * process. For this reason the incrementation takes place at the loop
-         * entry stage.
+         * Timed-out threads (not yet run after the timeout) are still present
+         * on the queue. They are skipped (removed) while waking-up.
          */
-next_iter:
-        sched.cur_thrd = (sched.cur_thrd + 1) % CONFIG_MAX_THREADS;
+        if (_IS_WAIT(sched.thrds[_THRD_IDX(id)].state))
+        {
+            coop_dbg_log_cb("Thread #%d WAIT -> RUN (wait-queue %p)\n",
+                _THRD_IDX(id), (void*)wq);
+
+            _wait_wakeup(_THRD_IDX(id));
+            break;
+        }
+    }
+    return id;
+}
+#endif /* __COOP_WQ */
+
+#ifdef CONFIG_OPT_MUTEX
+coop_error_t coop_mutex_lock(coop_mutex_t *mtx, coop_period_t timeout)
+{
+    if (!mtx->owner) {
+        mtx->owner = _THRD_ID(sched.cur_thrd);
+        return COOP_SUCCESS;
+    } else
+    if (mtx->owner == _THRD_ID(sched.cur_thrd)) {
+        return COOP_ERR_INV_ARG;
+    }
 
-        switch (sched.thrds[sched.cur_thrd].state)
-        {
-        case EMPTY:
-#ifndef CONFIG_NOEXIT_STATIC_THREADS
-        case HOLE:
-#endif
-        default:
-            goto next_iter;
+    /* mutex ownership is passed by the unlocking thread */
+    return _wq_wait(&mtx->wq, mtx, timeout);
+}
 
-#ifdef CONFIG_OPT_IDLE
-        case IDLE:
-            if (!COOP_IS_TICK_OVER(
-                    coop_tick_cb(), sched.thrds[sched.cur_thrd].idle_to))
-            {
-                /* the current thread is idle but other threads are running;
-                   system can't switch to the idle state in this case */
-                goto next_iter;
-            }
+bool coop_mutex_trylock(coop_mutex_t *mtx)
+{
+    if (!mtx->owner) {
+        mtx->owner = _THRD_ID(sched.cur_thrd);
+        return true;
+    }
+    return false;
+}
 
-            /* idle time passed; continue as in RUN state  */
-            coop_dbg_log_cb("Thread #%d IDLE -> RUN (via sched-loop)\n",
-                sched.cur_thrd);
-            sched.thrds[sched.cur_thrd].state = RUN;
-            sched.idle_n--;
-            goto run;
-#endif
+coop_error_t coop_mutex_unlock(coop_mutex_t *mtx)
+{
+    if (mtx->owner != _THRD_ID(sched.cur_thrd)) {
+        return COOP_ERR_INV_ARG;
+    }
 
-#ifdef CONFIG_OPT_WAIT
-        case WAIT:
-            if (sched.thrds[sched.cur_thrd].wait_flgs.inf ||
-                !COOP_IS_TICK_OVER(
-                    coop_tick_cb(), sched.thrds[sched.cur_thrd].wait_to))
-            {
-                /* not-notified infinite or not yet timed-out waiting thread */
-                goto next_iter;
-            }
+    /* pass the ownership to the first waiting thread (if any) */
+    mtx->owner = _wq_wake(&mtx->wq);
+    return COOP_SUCCESS;
+}
+#endif /* CONFIG_OPT_MUTEX */
 
-            coop_dbg_log_cb(
-                "Thread #%d WAIT -> RUN (timed-out)\n", sched.cur_thrd);
+#ifdef CONFIG_OPT_WAIT_ADDR
+/* address to its wait-queue (bucket) mapping */
+# define _ADDR_WQ(_addr) (&sched.addr_wqs[ \
+    ((size_t)(_addr) / sizeof(int)) % CONFIG_WAIT_ADDR_BUCKETS])
 
-            /* wait time passed; continue as in RUN state  */
-            sched.thrds[sched.cur_thrd].state = RUN;
-# ifdef CONFIG_OPT_IDLE
-            sched.idle_n--;
-# endif
-            goto run;
-#endif
+coop_error_t coop_wait_addr(
+    const int *addr, int expected, coop_period_t timeout)
+{
+    coop_error_t ret;
 
-        case RUN:
-#if defined(CONFIG_OPT_IDLE) || defined(CONFIG_OPT_WAIT)
-run:
-#endif
-            /* sched_pos_run: main-running scheduler execution context */
-            if (!setjmp(sched.exe_ctx))
-            {
-                coop_dbg_log_cb("setjmp sched_pos_run; run thread #%d: "
-                    "longjmp thrd_pos_[new/run]\n", sched.cur_thrd);
+    if (*(const volatile int*)addr != expected) {
+        return COOP_SUCCESS;
+    }
 
-#ifdef CONFIG_OPT_YIELD_AFTER
-                sched.thrds[sched.cur_thrd].switch_tick = coop_tick_cb();
-#endif
-                /* jump to running thread: thrd_pos_new, thrd_pos_run */
-                longjmp(sched.thrds[sched.cur_thrd].exe_ctx, 1);
-            } else {
-                /* return from yielded running thread or restore
-                   scheduler stack after thread terminated as a hole */
-                coop_dbg_log_cb("Back to scheduler from #%d thread\n",
-                    sched.cur_thrd);
-            }
-            break;
+    sched.thrds[sched.cur_thrd].wait_addr = addr;
+    ret = _wq_wait(_ADDR_WQ(addr), addr, timeout);
+    sched.thrds[sched.cur_thrd].wait_addr = NULL;
 
-        case NEW:
-#ifdef CONFIG_NOEXIT_STATIC_THREADS
-            coop_dbg_log_cb("New thread #%d\n", sched.cur_thrd);
+    return ret;
+}
 
-# ifdef CONFIG_OPT_YIELD_AFTER
-            sched.thrds[sched.cur_thrd].switch_tick = coop_tick_cb();
-# endif
-            /* enter the thread routine */
-            sched.thrds[sched.cur_thrd].proc(sched.thrds[sched.cur_thrd].arg);
+unsigned coop_wake_addr(const void *addr, unsigned n)
+{
+    coop_wq_t *wq = _ADDR_WQ(addr);
+    unsigned id, next, prev = 0, woken = 0;
 
-            /* thread configured with CONFIG_NOEXIT_STATIC_THREADS
-               is not expected to finish */
-            coop_dbg_log_cb("UNEXPECTED: Thread #%d: RUN -> EMPTY\n",
-                sched.cur_thrd);
-            sched.thrds[sched.cur_thrd].state = EMPTY;
-            sched.busy_n--;
-            break;
-#else
-            /* sched_pos_entry_thrd: save a new thread entry stack state */
-            if (!setjmp(sched.thrds[sched.cur_thrd].entry_ctx))
-            {
-                coop_dbg_log_cb("setjmp sched_pos_entry_thrd; new thread #%d\n",
-                    sched.cur_thrd);
+    for (id = wq->head; id && (!n || woken < n); id = next)
+    {
+        register unsigned i = _THRD_IDX(id);
+        next = sched.thrds[i].wq_next;
 
-                sched.depth++;
-                sched.thrds[sched.cur_thrd].depth = sched.depth;
+        if (_IS_WAIT(sched.thrds[i].state) && sched.thrds[i].wait_addr != addr) {
+            /* other address hashed into the same bucket */
+            prev = id;
+            continue;
+        }
 
-# ifdef CONFIG_OPT_YIELD_AFTER
-                sched.thrds[sched.cur_thrd].switch_tick = coop_tick_cb();
+        /* notified or timed-out thread; remove from the bucket */
+        if (prev) {
+            sched.thrds[_THRD_IDX(prev)].wq_next = next;
+        } else {
+            wq->head = next;
+        }
+        if (wq->tail == id) wq->tail = prev;
+
+        if (_IS_WAIT(sched.thrds[i].state)) {
+            coop_dbg_log_cb("Thread #%d WAIT -> RUN (wake on address %p)\n",
+                i, addr);
+
+            _wait_wakeup(i);
+            woken++;
+        }
+    }
+# ifdef CONFIG_OPT_PROF
+    if (!woken) _prof_lost(0, addr);
 # endif
-                /* enter the thread routine */
-                sched.thrds[sched.cur_thrd].proc(sched.thrds[sched.cur_thrd].arg);
+    return woken;
+}
+#endif /* CONFIG_OPT_WAIT_ADDR */
 
-                /*
-                 * At this point the current thread is being terminated.
-                 * Scheduler stack is set at the thread stack frame, therefore
-                 * need to be updated:
-                 *
-                 * - If the terminating thread stack depth is less than the
-                 *   number of threads stacks occupying the main stack, the
-                 *   thread constitutes a hole (a terminated thread with its
-                 *   stack still occupying the main stack space). In this case
-                 *   the scheduler stack frame is restored to its previous
-                 *   position. No stack unwind occurs.
-                 *
-                 * - If the terminating thread stack depth is equal to the
-                 *   number of threads stacks occupying the main stack - the
-                 *   stack unwind occurs. In this case the scheduler stack
-                 *   frame is set to the position of an already terminated
-                 *   thread stack frame (possibly a hole) just above a started
-                 *   thread with most shallow stack.
-                 */
-                if (sched.thrds[sched.cur_thrd].depth < sched.depth)
-                {
-                    coop_dbg_log_cb("Thread #%d: RUN -> HOLE; "
-                        "scheduler stack-restore: longjmp sched_pos_run\n",
-                        sched.cur_thrd);
+#ifdef CONFIG_OPT_RING
+coop_error_t coop_ring_init(coop_ring_t *ring, unsigned char *buf, size_t size)
+{
+    if (!ring || !buf || size < 2 || size > 0x100 || (size & (size - 1))) {
+        return COOP_ERR_INV_ARG;
+    }
 
-                    sched.thrds[sched.cur_thrd].state = HOLE;
-                    sched.hole_n++;
+    ring->buf = buf;
+    ring->mask = (unsigned char)(size - 1);
+    ring->head = ring->tail = 0;
+    return COOP_SUCCESS;
+}
 
-                    /* restore previous scheduler stack frame; sched_pos_run jump */
-                    longjmp(sched.exe_ctx, 1);
-                } else
-                {
-                    register unsigned unwnd_thrd = _mark_unwind_thrds();
+bool coop_ring_put(coop_ring_t *ring, unsigned char c)
+{
+    register unsigned char head = ring->head;
+    register unsigned char next = (unsigned char)((head + 1) & ring->mask);
 
-                    coop_dbg_log_cb("Unwind scheduler stack at #%d thread entry "
-                        "context: longjmp sched_pos_entry_thrd\n", unwnd_thrd);
+    if (next == ring->tail) {
+        /* ring is full */
+        return false;
+    }
 
-                    /* unwind scheduler stack; sched_pos_entry_thrd jump */
-                    longjmp(sched.thrds[unwnd_thrd].entry_ctx, 1);
-                }
-            } else {
-                /* return with unwinded stack; new scheduler stack frame
-                   from this point */
-                coop_dbg_log_cb("Back to scheduler; stack unwinded\n");
-            }
-            break;
-#endif /* CONFIG_NOEXIT_STATIC_THREADS */
+    /* data need to be written before updating the head */
+    ring->buf[head] = c;
+    ring->head = next;
+
+    ring_pend = true;
+    return true;
+}
+
+coop_error_t coop_ring_get(
+    coop_ring_t *ring, unsigned char *c, coop_period_t timeout)
+{
+    register unsigned char tail;
+
+    if (_RING_EMPTY(ring))
+    {
+        coop_dbg_log_cb("Thread #%d waiting on ring %p\n",
+            sched.cur_thrd, (void*)ring);
+
+        sched.thrds[sched.cur_thrd].cv = ring;
+        sched.thrds[sched.cur_thrd].wait_flgs.ring = 1;
+        _wait_prep(timeout);
+
+        _yield(WAIT);
+
+        sched.thrds[sched.cur_thrd].wait_flgs.ring = 0;
+        if (_RING_EMPTY(ring)) {
+            coop_dbg_log_cb("Thread #%d ring wait-timeout\n", sched.cur_thrd);
+            return COOP_ERR_TIMEOUT;
         }
     }
 
-#ifdef CONFIG_NOEXIT_STATIC_THREADS
-    /*
-     * Can't exit the routine since stack has not been unwinded
-     * up to its entry point. Assertion will fire in this case.
-     */
-    coop_dbg_log_cb("UNEXPECTED: coop_sched_service() exits!\n");
-    assert(false);
-#else
-    _sched_init(true);
-#endif
+    tail = ring->tail;
+    *c = ring->buf[tail];
+    ring->tail = (unsigned char)((tail + 1) & ring->mask);
+
+    return COOP_SUCCESS;
 }
+#endif /* CONFIG_OPT_RING */
 
-coop_error_t coop_sched_thread(coop_thrd_proc_t proc, const char *name,
-    size_t stack_sz, void *arg)
+#ifdef CONFIG_OPT_BCAST
+/* broadcast ring slot of element with sequence @c _seq */
+# define _BCAST_SLOT(_bc, _seq) \
+    ((_bc)->buf + ((_seq) & (_bc)->mask) * (_bc)->elem_sz)
+
+coop_error_t coop_bcast_init(
+    coop_bcast_t *bc, void *buf, size_t elem_sz, size_t elems_n)
 {
-    if (!proc) {
+    if (!bc || !buf || !elem_sz || elems_n < 2 || (elems_n & (elems_n - 1))) {
         return COOP_ERR_INV_ARG;
-    } else
-    if (sched.busy_n >= CONFIG_MAX_THREADS) {
-        return COOP_ERR_LIMIT;
     }
 
-    _sched_init(false);
+    bc->buf = (unsigned char*)buf;
+    bc->elem_sz = elem_sz;
+    bc->mask = (unsigned long)(elems_n - 1);
+    bc->seq = 0;
+    bc->wq.head = bc->wq.tail = 0;
 
-    for (unsigned i = 0; i < CONFIG_MAX_THREADS; i++) {
-        if (sched.thrds[i].state == EMPTY)
-        {
-            sched.thrds[i].proc = proc;
-            sched.thrds[i].name = name;
-            sched.thrds[i].stack = NULL;
-            sched.thrds[i].stack_sz =
-                (!stack_sz ? CONFIG_DEFAULT_STACK_SIZE : stack_sz);
-            sched.thrds[i].arg = arg;
-            sched.thrds[i].state = NEW;
-#ifndef CONFIG_NOEXIT_STATIC_THREADS
-            sched.thrds[i].depth = 0;
-            memset(sched.thrds[i].entry_ctx, 0, sizeof(sched.thrds[i].entry_ctx));
-#endif
-            memset(sched.thrds[i].exe_ctx, 0, sizeof(sched.thrds[i].exe_ctx));
+    return COOP_SUCCESS;
+}
 
-            sched.busy_n++;
-            coop_dbg_log_cb("Thread #%d scheduled to run\n", i);
-            break;
+void coop_bcast_subscribe(const coop_bcast_t *bc, coop_bcast_sub_t *sub)
+{
+    sub->seq = bc->seq;
+    sub->overruns = 0;
+}
+
+void *coop_bcast_claim(coop_bcast_t *bc)
+{
+    return _BCAST_SLOT(bc, bc->seq);
+}
+
+void coop_bcast_publish(coop_bcast_t *bc)
+{
+    bc->seq++;
+
+    /* wake-up the waiting subscribers only */
+    while (_wq_wake(&bc->wq));
+}
+
+coop_error_t coop_bcast_get(coop_bcast_t *bc,
+    coop_bcast_sub_t *sub, const void **elem, coop_period_t timeout)
+{
+    register unsigned long lag;
+
+    if (sub->seq == bc->seq)
+    {
+        /* caught up with the producer */
+        _wq_wait(&bc->wq, bc, timeout);
+
+        /* element published since the time-out is not lost */
+        if (sub->seq == bc->seq) {
+            coop_dbg_log_cb("Thread #%d broadcast wait-timeout\n",
+                sched.cur_thrd);
+            return COOP_ERR_TIMEOUT;
         }
     }
+
+    /* the slot of the next element to publish is not readable */
+    lag = bc->seq - sub->seq;
+    if (lag > bc->mask)
+    {
+        /* slow subscriber; skip overwritten elements */
+        coop_dbg_log_cb("Thread #%d broadcast overrun by %lu elements\n",
+            sched.cur_thrd, lag - bc->mask);
+
+        sub->overruns += lag - bc->mask;
+        sub->seq = bc->seq - bc->mask;
+    }
+
+    *elem = _BCAST_SLOT(bc, sub->seq);
+    sub->seq++;
+
     return COOP_SUCCESS;
 }
 
-const char *coop_thread_name(void)
+unsigned long coop_bcast_overruns(const coop_bcast_sub_t *sub)
+{
+    return sub->overruns;
+}
+#endif /* CONFIG_OPT_BCAST */
+
+#ifdef CONFIG_OPT_RCU
+void coop_synchronize_rcu(void)
+{
+    /* back to the thread after the scheduler switch point */
+    _yield(RUN);
+}
+
+void coop_call_rcu(coop_rcu_head_t *head, void (*func)(coop_rcu_head_t *head))
+{
+    head->next = NULL;
+    head->func = func;
+
+    if (sched.rcu_tail) {
+        sched.rcu_tail->next = head;
+    } else {
+        sched.rcu_head = head;
+    }
+    sched.rcu_tail = head;
+}
+#endif /* CONFIG_OPT_RCU */
+
+#ifdef CONFIG_OPT_MALLOC
+/* smallest size class */
+# define MALLOC_MIN_BLOCK 8U
+
+/* size class of blocks allocated by the platform malloc() */
+# define MALLOC_CLASS_PLAT 0xff
+
+# ifdef CONFIG_UNIX_MALLOC_WRAP
+/* the platform heap bypassing its wrappers (accounted by coop_malloc()) */
+void *__real_malloc(size_t size);
+void __real_free(void *ptr);
+#  define _PLAT_MALLOC(_size) __real_malloc(_size)
+#  define _PLAT_FREE(_ptr) __real_free(_ptr)
+# else
+#  define _PLAT_MALLOC(_size) malloc(_size)
+#  define _PLAT_FREE(_ptr) free(_ptr)
+# endif
+
+/**
+ * Memory block header. Precedes allocated memory block and assures its
+ * alignment.
+ */
+typedef union
+{
+    struct {
+        /** Memory block size class. */
+        unsigned char cls;
+# ifdef __COOP_MEM_STATS
+        /** Owning (allocating) thread; not set if allocated outside threads. */
+        coop_mem_owner_t owner;
+
+        /** Accounted memory block size. */
+        size_t size;
+# endif
+    } i;
+
+    /* alignment */
+    long long ll;
+    double d;
+    void *p;
+} coop_mblk_hdr_t;
+
+/**
+ * Free memory block. Overlays a memory block put on a free-list.
+ */
+typedef struct coop_mblk_free
 {
-    return sched.thrds[sched.cur_thrd].name;
-}
+    struct coop_mblk_free *next;
+} coop_mblk_free_t;
 
 /**
- * @c new_state specifies a state to set before yielding (RUN, IDLE, WAIT).
+ * Memory allocator context.
+ *
+ * NOTE: The context is not a part of the scheduler context, since allocated
+ * memory blocks may outlive the scheduler service.
  */
-static inline void _yield(coop_thrd_state_t new_state)
+static struct
 {
-    if (sched.thrds[sched.cur_thrd].state == NEW) {
-        sched.thrds[sched.cur_thrd].state = new_state;
+    /** Number of arena bytes already carved for memory blocks. */
+    size_t used;
 
-        /* thrd_pos_new: newly created thread context */
-        if (!setjmp(sched.thrds[sched.cur_thrd].exe_ctx))
-        {
-            coop_dbg_log_cb("setjmp thrd_pos_new; thread #%d: NEW -> %s\n",
-                sched.cur_thrd, _state_name(sched.cur_thrd));
+    /** Size classes free-lists. */
+    coop_mblk_free_t *free[CONFIG_MALLOC_CLASSES];
 
-            /* allocate thread stack */
-            /*
-             * NOTE: For performance reason the allocation takes place after
-             * the call to the thread routine while the routine yields its
-             * control to the scheduler for the first time (there is no point
-             * to allocate thread's stack for a routine which simply enters and
-             * immediately exists without yielding to the scheduler, since the
-             * stack would not be used in such case).
-             * For this reason the stack used by the thread is (in most cases)
-             * larger than the size indicated by its requested value. This extra
-             * space is the one which has already been allocated while entering
-             * the thread routine for the first time (so embracing all or part
-             * of its local variables created on the stack new frame).
-             * This approach has this benefit, a library user needs not to take
-             * care about thread local variables size calculation occupying its
-             * stack, since by moving them to the routine's main scope they will
-             * be allocated on the thread stack frame while entering the routine.
-             * Library user's requested stack size must in this case embrace
-             * stack space which is used dynamically by the thread during its
-             * lifetime (including preemptive ISRs).
-             */
-            sched.thrds[sched.cur_thrd].stack =
-                alloca(sched.thrds[sched.cur_thrd].stack_sz);
-            memset(sched.thrds[sched.cur_thrd].stack, STACK_PADD,
-                sched.thrds[sched.cur_thrd].stack_sz);
+    /** Memory arena. */
+    union {
+        unsigned char b[CONFIG_MALLOC_ARENA_SIZE];
+        coop_mblk_hdr_t align;
+    } arena;
+} malloc_ctx;
 
-            /* build new thread stack via recurrent scheduler service call */
-            coop_sched_service();
-        } else {
-            /* return from scheduler; first run */
-            coop_dbg_log_cb("Back to #%d thread (via thrd_pos_new)\n",
-                sched.cur_thrd);
-        }
-    } else {
-        sched.thrds[sched.cur_thrd].state = new_state;
-#ifdef COOP_DEBUG
-        if (new_state != RUN) {
-            coop_dbg_log_cb("Thread #%d: RUN -> %s\n",
-                sched.cur_thrd, _state_name(sched.cur_thrd));
-        }
-#endif
+/**
+ * Put memory block @c hdr back to its size class free-list (or the platform
+ * heap).
+ */
+static void _mblk_put(coop_mblk_hdr_t *hdr)
+{
+# ifdef CONFIG_MALLOC_FALLBACK
+    if (hdr->i.cls == MALLOC_CLASS_PLAT) {
+        _PLAT_FREE(hdr);
+        return;
+    }
+# endif
+    ((coop_mblk_free_t*)(hdr + 1))->next = malloc_ctx.free[hdr->i.cls];
+    malloc_ctx.free[hdr->i.cls] = (coop_mblk_free_t*)(hdr + 1);
+}
 
-        /* thrd_pos_run: main-running thread context */
-        if (!setjmp(sched.thrds[sched.cur_thrd].exe_ctx))
-        {
-            coop_dbg_log_cb("setjmp thrd_pos_run; back from #%d thread to "
-                "scheduler: longjmp sched_pos_run\n", sched.cur_thrd);
+void *coop_malloc(size_t size)
+{
+    register unsigned cls;
+    register size_t blk_sz;
+    coop_mblk_hdr_t *hdr = NULL;
 
-            /* back to scheduler: sched_pos_run jump */
-            longjmp(sched.exe_ctx, 1);
-        } else {
-            /* return from scheduler; regular run */
-            coop_dbg_log_cb("Back to #%d thread (via thrd_pos_run)\n",
-                sched.cur_thrd);
+    for (cls = 0, blk_sz = MALLOC_MIN_BLOCK;
+        cls < CONFIG_MALLOC_CLASSES && blk_sz < size;
+        cls++, blk_sz <<= 1);
+
+    if (cls < CONFIG_MALLOC_CLASSES)
+    {
+        if (malloc_ctx.free[cls]) {
+            /* reuse freed block */
+            hdr = (coop_mblk_hdr_t*)malloc_ctx.free[cls] - 1;
+            malloc_ctx.free[cls] = malloc_ctx.free[cls]->next;
+        } else
+        if (CONFIG_MALLOC_ARENA_SIZE - malloc_ctx.used >=
+            sizeof(coop_mblk_hdr_t) + blk_sz)
+        {
+            /* carve new block from the arena */
+            hdr = (coop_mblk_hdr_t*)&malloc_ctx.arena.b[malloc_ctx.used];
+            malloc_ctx.used += sizeof(coop_mblk_hdr_t) + blk_sz;
         }
     }
+
+# ifdef CONFIG_MALLOC_FALLBACK
+    if (!hdr) {
+        cls = MALLOC_CLASS_PLAT;
+        hdr = (coop_mblk_hdr_t*)_PLAT_MALLOC(sizeof(coop_mblk_hdr_t) + size);
+    }
+# endif
+    if (!hdr) {
+        coop_dbg_log_cb("Memory allocation of %lu bytes failed\n",
+            (unsigned long)size);
+        return NULL;
+    }
+
+    hdr->i.cls = (unsigned char)cls;
+# ifdef __COOP_MEM_STATS
+    hdr->i.size = size;
+    if (coop_mem_charge(size, &hdr->i.owner) != COOP_SUCCESS) {
+        _mblk_put(hdr);
+        return NULL;
+    }
+# endif
+    return hdr + 1;
 }
 
-#ifdef CONFIG_OPT_IDLE
-void coop_idle(coop_tick_t period)
+void coop_free(void *ptr)
 {
-    coop_thrd_state_t new_state = RUN;
+    coop_mblk_hdr_t *hdr = (coop_mblk_hdr_t*)ptr - 1;
 
-    if (period > 0) {
-        coop_dbg_log_cb("Thread #%d going idle for %lu ticks\n",
-            sched.cur_thrd, (unsigned long)period);
+    if (!ptr) return;
 
-        new_state = IDLE;
-        sched.idle_n++;
-        sched.thrds[sched.cur_thrd].idle_to = coop_tick_cb() + period;
+# ifdef __COOP_MEM_STATS
+    coop_mem_uncharge(&hdr->i.owner, hdr->i.size);
+# endif
+    _mblk_put(hdr);
+}
+#endif /* CONFIG_OPT_MALLOC */
+
+#ifdef CONFIG_OPT_STATS
+coop_error_t coop_thread_stats(unsigned thrd, coop_thrd_stats_t *stats)
+{
+    register coop_thrd_ctx_t *ctx;
+
+    if (thrd == COOP_CUR_THRD) {
+        thrd = sched.cur_thrd;
     }
-    _yield(new_state);
+    if (thrd >= CONFIG_MAX_THREADS || !stats) {
+        return COOP_ERR_INV_ARG;
+    }
+
+    ctx = &sched.thrds[thrd];
+    if (ctx->state == EMPTY
+# ifndef CONFIG_NOEXIT_STATIC_THREADS
+        || ctx->state == HOLE
+# endif
+        )
+    {
+        return COOP_ERR_INV_ARG;
+    }
+
+    stats->name = ctx->name;
+    stats->state = _state_name(thrd);
+    stats->run_ticks = ctx->run_ticks;
+    stats->switch_n = ctx->switch_n;
+# ifdef CONFIG_OPT_STACK_WM
+    stats->stack_wm = _stack_wm(thrd);
+# elif defined(CONFIG_OPT_STACK_WM_SP)
+    stats->stack_wm = _stack_wm_sp(thrd);
+# endif
+# ifdef CONFIG_OPT_WAIT
+    stats->wait_sem = (_IS_WAIT(ctx->state) ? ctx->sem_id : 0);
+    stats->wait_obj = (_IS_WAIT(ctx->state) ? _wait_obj(thrd) : NULL);
+# endif
+# ifdef __COOP_MEM_STATS
+    stats->mem_cur = ctx->mem_cur;
+    stats->mem_peak = ctx->mem_peak;
+    stats->mem_total = ctx->mem_total;
+    stats->mem_limit = ctx->mem_limit;
+# endif
+    return COOP_SUCCESS;
 }
-#else
-void coop_yield(void)
+
+void coop_sched_stats(coop_sched_stats_t *stats)
 {
-    _yield(RUN);
+    stats->switch_n = sched.switch_n;
+    stats->idle_n = sched.idle_n_cb;
+    stats->busy_n = sched.busy_n;
 }
-#endif
 
-#ifdef CONFIG_OPT_YIELD_AFTER
-void coop_yield_after(coop_tick_t *after, coop_tick_t period)
+void coop_stats_export(struct coop_stats_exp *exp)
 {
-    if (COOP_IS_TICK_OVER(coop_tick_cb(), *after))
-    {
-        coop_dbg_log_cb("Thread #%d yields after %lu tick\n",
-            sched.cur_thrd, (unsigned long)*after);
+    _sched_init(false);
 
-        _yield(RUN);
-        *after = coop_tick_cb() + period;
+    if ((sched.stats_exp = exp) != NULL) {
+        memset(exp, 0, COOP_STATS_EXP_SIZE(CONFIG_MAX_THREADS));
+        exp->magic = COOP_STATS_MAGIC;
+        exp->thrds_n = CONFIG_MAX_THREADS;
+        exp->res = 0;
+        _stats_export(CONFIG_MAX_THREADS, true);
     }
 }
-#endif
 
-#ifdef CONFIG_OPT_WAIT
-coop_error_t coop_wait_cond(
-    int sem_id, coop_tick_t timeout, coop_predic_proc_t predic, void *cv)
+# ifdef __COOP_MEM_STATS
+void coop_thread_mem_limit(size_t limit)
 {
-    sched.thrds[sched.cur_thrd].sem_id = sem_id;
-    sched.thrds[sched.cur_thrd].predic = predic;
-    sched.thrds[sched.cur_thrd].cv = cv;
-    sched.thrds[sched.cur_thrd].wait_flgs.notif = 0;
-    if (timeout) {
-        sched.thrds[sched.cur_thrd].wait_to = coop_tick_cb() + timeout;
-        sched.thrds[sched.cur_thrd].wait_flgs.inf = 0;
+    sched.thrds[sched.cur_thrd].mem_limit = limit;
+}
 
-        coop_dbg_log_cb("Thread #%d waiting with timeout %lu ticks; "
-            "sem_id: %d\n", sched.cur_thrd, (unsigned long)timeout, sem_id);
-    } else {
-        sched.thrds[sched.cur_thrd].wait_to = 0;
-        sched.thrds[sched.cur_thrd].wait_flgs.inf = 1;
+coop_error_t coop_mem_charge(size_t size, coop_mem_owner_t *owner)
+{
+    register coop_thrd_ctx_t *ctx;
 
-        coop_dbg_log_cb("Thread #%d waiting infinitely; sem_id: %d\n",
-            sched.cur_thrd, sem_id);
+    owner->thrd = owner->gen = 0;
+    if (!sched.in_thrd) {
+        /* not accounted */
+        return COOP_SUCCESS;
     }
-# ifdef CONFIG_OPT_IDLE
-    sched.idle_n++;
-# endif
 
-    _yield(WAIT);
-
-    if (sched.thrds[sched.cur_thrd].wait_flgs.notif != 0) {
-        coop_dbg_log_cb("Thread #%d notified on sem_id: %d\n",
-            sched.cur_thrd, sem_id);
-        return COOP_SUCCESS;
-    } else {
-        coop_dbg_log_cb("Thread #%d wait-timeout; sem_id: %d\n",
-            sched.cur_thrd, sem_id);
-        return COOP_ERR_TIMEOUT;
+    ctx = &sched.thrds[sched.cur_thrd];
+    if (ctx->mem_limit && ctx->mem_cur + size > ctx->mem_limit)
+    {
+        coop_dbg_log_cb("Thread #%d memory limit exceeded\n", sched.cur_thrd);
+        coop_mem_limit_cb(ctx->name, size);
+        return COOP_ERR_LIMIT;
     }
+
+    owner->thrd = sched.cur_thrd + 1;
+    owner->gen = ctx->mem_gen;
+
+    ctx->mem_cur += size;
+    ctx->mem_total += size;
+    if (ctx->mem_peak < ctx->mem_cur)
+        ctx->mem_peak = ctx->mem_cur;
+
+    return COOP_SUCCESS;
 }
 
-static inline void _notify(int sem_id, bool single)
+void coop_mem_uncharge(const coop_mem_owner_t *owner, size_t size)
 {
-    for (unsigned i = 0; i < CONFIG_MAX_THREADS; i++) {
-        if (_IS_WAIT(sched.thrds[i].state) &&
-            sched.thrds[i].sem_id == sem_id &&
-            (!sched.thrds[i].predic || sched.thrds[i].predic(sched.thrds[i].cv)))
-        {
-            coop_dbg_log_cb("Thread #%d WAIT -> RUN (%s-notify on sem_id: %d)\n",
-                i, (single ? "single" : "all"), sem_id);
+#  ifdef CONFIG_OPT_NESTED_SCHED
+    register coop_sched_ctx_t *s = &root_sched;
+#  else
+    register coop_sched_ctx_t *s = &sched;
+#  endif
+    register coop_thrd_ctx_t *ctx;
 
-            sched.thrds[i].wait_flgs.notif = 1;
-            sched.thrds[i].state = RUN;
-# ifdef CONFIG_OPT_IDLE
-            sched.idle_n--;
-# endif
-            if (single) break;
+    if (!owner->thrd) return;
+
+    /*
+     * The owner is looked up by its generation, since the slot might have been
+     * reused by other thread. The generations are unique across schedulers,
+     * therefore the owner is looked up on all running schedulers (a block
+     * may be freed by a thread of other scheduler than the owner's one).
+     */
+    do {
+        ctx = &s->thrds[owner->thrd - 1];
+        if (ctx->mem_gen == owner->gen) {
+            /* not terminated */
+            if (ctx->state != EMPTY
+#  ifndef CONFIG_NOEXIT_STATIC_THREADS
+                && ctx->state != HOLE
+#  endif
+                )
+            {
+                ctx->mem_cur -= size;
+            }
+            break;
         }
-    }
+#  ifdef CONFIG_OPT_NESTED_SCHED
+        s = s->next;
+#  else
+        s = NULL;
+#  endif
+    } while (s);
 }
+# endif
+#endif /* CONFIG_OPT_STATS */
 
-void coop_notify(int sem_id)
+#ifdef CONFIG_OPT_PROF
+unsigned coop_prof_report(coop_prof_stats_t *report, unsigned n)
 {
-    _notify(sem_id, true);
+    unsigned i, j;
+
+    if (n > prof_ctx.n) n = prof_ctx.n;
+
+    /* top n entries by total blocked time (insertion sort) */
+    for (i = j = 0; i < prof_ctx.n; i++, j = (j < n ? j + 1 : n))
+    {
+        register unsigned k = j;
+
+        while (k > 0 && report[k - 1].total < prof_ctx.ents[i].total) {
+            if (k < n) report[k] = report[k - 1];
+            k--;
+        }
+        if (k < n) report[k] = prof_ctx.ents[i];
+    }
+    return n;
 }
 
-void coop_notify_all(int sem_id)
+void coop_prof_reset(void)
 {
-    _notify(sem_id, false);
+    prof_ctx.n = 0;
 }
-#endif /* CONFIG_OPT_WAIT */
+#endif /* CONFIG_OPT_PROF */
 
 #ifdef CONFIG_OPT_STACK_WM
 size_t coop_stack_wm()
 {
-    size_t stack_sz = sched.thrds[sched.cur_thrd].stack_sz;
-    unsigned char *stack = (unsigned char*)sched.thrds[sched.cur_thrd].stack;
-    size_t f, f2; /* free space water-marks */
-
-    if (!stack) {
-        /* stack not yet allocated (the routine called before first yield) */
-        return 0;
-    }
+    return _stack_wm(sched.cur_thrd);
+}
+#endif /* CONFIG_OPT_STACK_WM */
 
-    /* first check most common type of stack (growing into lower addresses) */
-    for (f = stack_sz; f && stack[f - 1] == STACK_PADD; f--);
-    f = stack_sz - f;
+#ifdef CONFIG_OPT_STACK_WM_SP
+void coop_stack_sample()
+{
+    unsigned char sp;
+    _stack_sample(&sp);
+}
 
-    if (f < sizeof(void*)) {
-        /* whole stack was filled up or the stack grows into higher addresses */
-        for (f2 = 0; f2 < stack_sz && stack[f2] == STACK_PADD; f2++);
+size_t coop_stack_wm_sp()
+{
+    return _stack_wm_sp(sched.cur_thrd);
+}
+#endif /* CONFIG_OPT_STACK_WM_SP */
 
-        /* assume growing into higher addresses type of stack */
-        if (f2 > f) f = f2;
+#ifdef CONFIG_OPT_STACK_LEARN
+void coop_stack_learn_save()
+{
+    if (sched.thrds[sched.cur_thrd].name && sched.thrds[sched.cur_thrd].stack)
+    {
+        coop_stack_learn_save_cb(
+            sched.thrds[sched.cur_thrd].name, _LEARN_WM(sched.cur_thrd));
     }
-    return (stack_sz - f);
 }
-#endif /* CONFIG_OPT_STACK_WM */
+#endif /* CONFIG_OPT_STACK_LEARN */
 
 #ifdef __TEST__
 bool coop_test_is_shallow()
@@ -785,4 +2585,79 @@ void *coop_test_get_stack(unsigned thrd) {
 void coop_test_set_stack(unsigned thrd, void *stack) {
     sched.thrds[thrd].stack = stack;
 }
+
+size_t coop_test_get_stack_sz(unsigned thrd) {
+    return sched.thrds[thrd].stack_sz;
+}
+
+unsigned coop_test_get_hole_n()
+{
+# ifdef CONFIG_NOEXIT_STATIC_THREADS
+    return 0;
+# else
+    return sched.hole_n;
+# endif
+}
+
+/*
+ * Check scheduler counters consistency with the threads pool. To be called
+ * from a thread routine.
+ */
+bool coop_test_check_invariants()
+{
+    unsigned i, busy_n = 0, idle_n = 0;
+# ifndef CONFIG_NOEXIT_STATIC_THREADS
+    unsigned d, n, hole_n = 0, depth_n = 0;
+
+/* thread occupies the main stack (NOTE: the current thread is in NEW state
+   until yielding for the first time) */
+#  define __ON_STACK(_i) (sched.thrds[_i].state == HOLE || \
+    _IS_STARTED(sched.thrds[_i].state) || (_i) == sched.cur_thrd)
+# endif
+
+    if (!sched.in_thrd || (sched.thrds[sched.cur_thrd].state != RUN &&
+        sched.thrds[sched.cur_thrd].state != NEW))
+    {
+        return false;
+    }
+
+    for (i = 0; i < CONFIG_MAX_THREADS; i++)
+    {
+        if (sched.thrds[i].state != EMPTY) busy_n++;
+        if (_IS_IDLE(sched.thrds[i].state) || _IS_WAIT(sched.thrds[i].state))
+            idle_n++;
+# ifndef CONFIG_NOEXIT_STATIC_THREADS
+        if (sched.thrds[i].state == HOLE) hole_n++;
+        if (__ON_STACK(i)) depth_n++;
+# endif
+    }
+
+    if (busy_n != sched.busy_n) return false;
+# ifdef CONFIG_OPT_IDLE
+    if (idle_n != sched.idle_n) return false;
+# else
+    (void)idle_n;
+# endif
+
+# ifndef CONFIG_NOEXIT_STATIC_THREADS
+    if (hole_n != sched.hole_n || depth_n != sched.depth) return false;
+
+    /* threads on the main stack occupy consecutive depth levels */
+    for (d = 1; d <= sched.depth; d++)
+    {
+        for (i = n = 0; i < CONFIG_MAX_THREADS; i++) {
+            if (__ON_STACK(i) && sched.thrds[i].depth == d) n++;
+        }
+        if (n != 1) return false;
+    }
+
+    /* the most shallow level is not a hole */
+    for (i = 0; i < CONFIG_MAX_THREADS; i++) {
+        if (sched.thrds[i].state == HOLE && sched.thrds[i].depth == sched.depth)
+            return false;
+    }
+#  undef __ON_STACK
+# endif
+    return true;
+}
 #endif
@@ -17,6 +17,70 @@
 #include <stddef.h> /* size_t */
 #include "coop_config.h"
 
+#if defined(CONFIG_OPT_MUTEX) && !defined(CONFIG_OPT_WAIT)
+# error CONFIG_OPT_MUTEX requires CONFIG_OPT_WAIT
+#endif
+#if defined(CONFIG_OPT_WAIT_ADDR) && !defined(CONFIG_OPT_WAIT)
+# error CONFIG_OPT_WAIT_ADDR requires CONFIG_OPT_WAIT
+#endif
+#if defined(CONFIG_OPT_RING) && !defined(CONFIG_OPT_WAIT)
+# error CONFIG_OPT_RING requires CONFIG_OPT_WAIT
+#endif
+#if defined(CONFIG_OPT_BCAST) && !defined(CONFIG_OPT_WAIT)
+# error CONFIG_OPT_BCAST requires CONFIG_OPT_WAIT
+#endif
+#if defined(CONFIG_OPT_WAIT_POLL) && !defined(CONFIG_OPT_WAIT)
+# error CONFIG_OPT_WAIT_POLL requires CONFIG_OPT_WAIT
+#endif
+#if defined(CONFIG_OPT_CHAN) && !defined(CONFIG_OPT_WAIT_POLL)
+# error CONFIG_OPT_CHAN requires CONFIG_OPT_WAIT_POLL
+#endif
+#if defined(CONFIG_OPT_CHAN) && !defined(__linux__)
+# error CONFIG_OPT_CHAN is supported on Linux only
+#endif
+#if defined(CONFIG_OPT_PROF) && !defined(CONFIG_OPT_WAIT)
+# error CONFIG_OPT_PROF requires CONFIG_OPT_WAIT
+#endif
+#if defined(CONFIG_OPT_IDLE_WORK) && !defined(CONFIG_OPT_IDLE)
+# error CONFIG_OPT_IDLE_WORK requires CONFIG_OPT_IDLE
+#endif
+#if defined(CONFIG_OPT_STACK_LEARN) && \
+    !(defined(CONFIG_OPT_STACK_WM) || defined(CONFIG_OPT_STACK_WM_SP))
+# error CONFIG_OPT_STACK_LEARN requires CONFIG_OPT_STACK_WM or \
+    CONFIG_OPT_STACK_WM_SP
+#endif
+#if defined(CONFIG_OPT_NESTED_SCHED) && defined(CONFIG_NOEXIT_STATIC_THREADS)
+# error CONFIG_OPT_NESTED_SCHED is incompatible with CONFIG_NOEXIT_STATIC_THREADS
+#endif
+#if defined(CONFIG_OPT_NESTED_SCHED) && defined(CONFIG_OPT_REMOTE_SPAWN)
+# error CONFIG_OPT_NESTED_SCHED is incompatible with CONFIG_OPT_REMOTE_SPAWN
+#endif
+#if defined(CONFIG_OPT_NESTED_SCHED) && defined(CONFIG_OPT_IDLE) && \
+    !defined(CONFIG_OPT_WAIT_POLL)
+# error CONFIG_OPT_NESTED_SCHED with CONFIG_OPT_IDLE requires \
+    CONFIG_OPT_WAIT_POLL
+#endif
+#if defined(CONFIG_OPT_REMOTE_SPAWN) && \
+    (CONFIG_REMOTE_SPAWN_QUEUE & (CONFIG_REMOTE_SPAWN_QUEUE - 1))
+# error CONFIG_REMOTE_SPAWN_QUEUE must be a power of 2
+#endif
+
+#if defined(CONFIG_OPT_MUTEX) || defined(CONFIG_OPT_WAIT_ADDR) || \
+    defined(CONFIG_OPT_BCAST)
+/* threads wait queues support */
+# define __COOP_WQ
+#endif
+
+#if defined(CONFIG_UNIX_MALLOC_WRAP) && !defined(CONFIG_OPT_STATS)
+# error CONFIG_UNIX_MALLOC_WRAP requires CONFIG_OPT_STATS
+#endif
+
+#if defined(CONFIG_OPT_STATS) && \
+    (defined(CONFIG_OPT_MALLOC) || defined(CONFIG_UNIX_MALLOC_WRAP))
+/* threads memory usage accounting */
+# define __COOP_MEM_STATS
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -50,6 +114,147 @@ typedef void (*coop_thrd_proc_t)(void *arg);
 typedef bool (*coop_predic_proc_t)(void *cv);
 #endif
 
+#ifdef __COOP_WQ
+/**
+ * Threads wait queue.
+ *
+ * FIFO list of threads waiting on a synchronization object. The list is
+ * linked via the threads contexts, therefore no additional memory is required
+ * regardless of the number of waiting threads. Threads are identified by
+ * their ids (thread slot index + 1); id 0 marks no thread.
+ *
+ * @note Internal type; its members shall not be accessed directly.
+ */
+typedef struct
+{
+    unsigned head;  /** First waiting thread id. */
+    unsigned tail;  /** Last waiting thread id. */
+} coop_wq_t;
+#endif
+
+#ifdef CONFIG_OPT_MUTEX
+/**
+ * Mutex type.
+ *
+ * Zeroed structure constitutes an unlocked mutex, therefore statically
+ * allocated mutexes need no explicit initialization. Otherwise use
+ * @ref COOP_MUTEX_INIT or @c memset() it to 0.
+ */
+typedef struct
+{
+    /** Owning thread id (thread slot index + 1); 0 if unlocked. */
+    unsigned owner;
+
+    /** Threads waiting for the mutex. */
+    coop_wq_t wq;
+} coop_mutex_t;
+
+/**
+ * Unlocked mutex initializer.
+ */
+# define COOP_MUTEX_INIT {0, {0, 0}}
+#endif
+
+#ifdef CONFIG_OPT_RING
+/**
+ * Single-producer, single-consumer ring buffer of bytes.
+ *
+ * The producer (usually an ISR) puts bytes into the ring without any locking.
+ * The consumer (a thread) waits for the data in the waiting state.
+ *
+ * @note Use @ref coop_ring_init() to initialize the structure; its members
+ *     shall not be accessed directly.
+ */
+typedef struct
+{
+    /** Ring buffer. */
+    volatile unsigned char *buf;
+
+    /** Ring buffer size - 1. */
+    unsigned char mask;
+
+    /** Write (producer) index. */
+    volatile unsigned char head;
+
+    /** Read (consumer) index. */
+    volatile unsigned char tail;
+} coop_ring_t;
+#endif
+
+#ifdef CONFIG_OPT_BCAST
+/**
+ * Single-producer broadcast ring of fixed size elements.
+ *
+ * Each element published by the producer is read by all subscribers, each
+ * of them reading the ring via its own cursor (see @ref coop_bcast_sub_t).
+ * The elements are written and read in place (no copying), the producer never
+ * waits for the subscribers.
+ *
+ * @note Use @ref coop_bcast_init() to initialize the structure; its members
+ *     shall not be accessed directly.
+ */
+typedef struct
+{
+    /** Ring buffer. */
+    unsigned char *buf;
+
+    /** Element size. */
+    size_t elem_sz;
+
+    /** Ring buffer size (number of elements) - 1. */
+    unsigned long mask;
+
+    /** Number of published elements (sequence of the next element). */
+    unsigned long seq;
+
+    /** Subscribers waiting for the next element. */
+    coop_wq_t wq;
+} coop_bcast_t;
+
+/**
+ * Broadcast ring subscriber (reading cursor).
+ *
+ * @note Use @ref coop_bcast_subscribe() to initialize the structure; its
+ *     members shall not be accessed directly.
+ */
+typedef struct
+{
+    /** Sequence of the next element to read. */
+    unsigned long seq;
+
+    /** Number of elements lost due to the ring overrun. */
+    unsigned long overruns;
+} coop_bcast_sub_t;
+#endif
+
+#ifdef CONFIG_OPT_CHAN
+/**
+ * Inter-process channel: single-producer, single-consumer ring of fixed size
+ * messages placed in POSIX shared memory segment. The channel is created by
+ * the receiving process and opened by the sending one.
+ *
+ * @note Use @ref coop_chan_create() or @ref coop_chan_open() to initialize the
+ *     structure; its members shall not be accessed directly.
+ */
+typedef struct
+{
+    /** Mapped channel segment. */
+    struct coop_chan_shm *shm;
+
+    /** Mapped segment length. */
+    size_t size;
+
+    /** Mapped doorbell of the peer process; NULL if not yet known. */
+    struct coop_bell *peer_bell;
+
+    /** Pid of the peer process @c peer_bell belongs to. */
+    long peer_pid;
+
+    /** Channel segment name (receiving side only; NULL otherwise). */
+    const char *name;
+} coop_chan_t;
+#endif
+
 /**
  * Clock tick type (must be some sort of unsigned integer).
  */
@@ -73,9 +278,25 @@ typedef unsigned long coop_tick_t;
 
 /**
  * Max allowed ticks period value.
+ *
+ * @note With @ref CONFIG_OPT_EXT_TICK enabled the limit doesn't apply to idle
+ *     periods and waiting timeouts (see @ref coop_period_t).
  */
 #define COOP_MAX_PERIOD (COOP_MAX_TICK - COOP_OVER_TICKS + 1)
 
+#ifdef CONFIG_OPT_EXT_TICK
+/**
+ * Idle period and waiting timeout type. Extended to 64-bit, therefore
+ * effectively not limited.
+ */
+typedef unsigned long long coop_period_t;
+#else
+/**
+ * Idle period and waiting timeout type.
+ */
+typedef coop_tick_t coop_period_t;
+#endif
+
 /**
  * Start scheduler service to run scheduled threads.
  * The routine returns when the last scheduled thread ends.
@@ -102,6 +323,69 @@ void coop_sched_service(void);
 coop_error_t coop_sched_thread(coop_thrd_proc_t proc, const char *name,
     size_t stack_sz, void *arg);
 
+#ifdef CONFIG_OPT_REMOTE_SPAWN
+/**
+ * Schedule a thread to run from any OS thread (or ISR).
+ *
+ * The spawn request is put into a lock-free injection queue (of
+ * @ref CONFIG_REMOTE_SPAWN_QUEUE size) and @ref coop_idle_wakeup_cb() is
+ * called to wake-up the scheduler if idle. The scheduler moves the queued
+ * requests into the threads pool at its switch points, as soon as there are
+ * free pool slots. Arguments are the same as for @ref coop_sched_thread().
+ *
+ * @return COOP_SUCCESS Function finished with success.
+ * @return COOP_ERR_INV_ARG Invalid argument.
+ * @return COOP_ERR_LIMIT The injection queue is full.
+ *
+ * @note The scheduler service exits if there are no threads to run, therefore
+ *     threads spawned remotely require the scheduler to be kept running by
+ *     at least one resident thread.
+ */
+coop_error_t coop_spawn_remote(coop_thrd_proc_t proc, const char *name,
+    size_t stack_sz, void *arg);
+#endif
+
+#ifdef CONFIG_OPT_NESTED_SCHED
+/**
+ * Run a child scheduler in the context of the current (host) thread.
+ *
+ * The child scheduler has its own threads pool (of @c CONFIG_MAX_THREADS
+ * size) and initially runs a single thread with the passed arguments (the same
+ * as for @ref coop_sched_thread()). Threads scheduled (by
+ * @ref coop_sched_thread()) from threads of the child scheduler are added into
+ * its pool. The routine returns when the last thread of the child scheduler
+ * ends.
+ *
+ * The child scheduler is isolated from its parent:
+ *
+ * - The host thread yields to the parent scheduler after each round of the
+ *   child threads pool, so the parent threads are not starved.
+ * - If all child threads are idle or waiting the host thread waits in the
+ *   parent scheduler up to the nearest child wake-up time (infinitely if
+ *   there is no such a time) or a child thread is woken-up by a ring buffer
+ *   data, a notification or its poll-predicate, instead of calling
+ *   @ref coop_idle_cb(). The system idle state is entered by the root
+ *   scheduler only.
+ * - Synchronization objects (mutexes, addresses, etc.) are scheduler specific
+ *   and shall not be shared between threads of different schedulers. The only
+ *   exception are semaphore notifications: @ref coop_notify() is passed to
+ *   the other schedulers if no thread of the current scheduler waits on the
+ *   semaphore, @ref coop_notify_all() is passed to all of them. Therefore an
+ *   ISR notification reaches its waiting threads regardless of a scheduler
+ *   running at the time.
+ *
+ * @return COOP_SUCCESS Function finished with success.
+ * @return COOP_ERR_INV_ARG Invalid argument or the routine is not called from
+ *     a thread routine.
+ *
+ * @note To be called from the thread routine only. Child scheduler context and
+ *     its threads stacks are allocated on the host thread stack, which size
+ *     shall embrace them.
+ */
+coop_error_t coop_sched_nested(coop_thrd_proc_t proc, const char *name,
+    size_t stack_sz, void *arg);
+#endif
+
 /**
  * Get currently running thread name (as passed to @ref coop_sched_thread()
  * during thread creation).
@@ -110,10 +394,20 @@ coop_error_t coop_sched_thread(coop_thrd_proc_t proc, const char *name,
  */
 const char *coop_thread_name(void);
 
+/**
+ * Check if the routine is called from a thread routine (as opposed to the
+ * code running outside of the scheduler or the scheduler callbacks).
+ *
+ * @return true Called from a thread routine.
+ * @return false Otherwise.
+ */
+bool coop_in_thread(void);
+
 #ifdef CONFIG_OPT_IDLE
 /**
  * Declare the currently running thread shall be idle for specific @c period
- * of ticks. The @period argument must not be greater than @ref COOP_MAX_PERIOD.
+ * of ticks. The @period argument must not be greater than @ref COOP_MAX_PERIOD
+ * unless @ref CONFIG_OPT_EXT_TICK is enabled.
  *
  * @note To be called from the thread routine only.
  *
@@ -129,7 +423,7 @@ const char *coop_thread_name(void);
  *     - Reduce time spend in the thread up to minimum. @ref coop_yield_after()
  *       may be helpful in this case.
  */
-void coop_idle(coop_tick_t period);
+void coop_idle(coop_period_t period);
 #endif
 
 #ifdef CONFIG_OPT_YIELD_AFTER
@@ -184,13 +478,48 @@ void coop_yield_after(coop_tick_t *after, coop_tick_t period);
 void coop_yield(void);
 #endif
 
+#ifdef CONFIG_OPT_IDLE_WORK
+/**
+ * Idle-work routine type.
+ *
+ * @param remain Number of clock ticks up to the nearest thread wake-up time;
+ *     0 if there is no such deadline (all threads are waiting infinitely).
+ *     The routine shall perform a chunk of its work fitting the period.
+ * @param arg User argument passed untouched to the routine.
+ *
+ * @return @c true if a chunk of work has been performed (the routine will be
+ *     called again if all threads are still idle), @c false if there is
+ *     nothing to do (the system goes idle via @ref coop_idle_cb()).
+ */
+typedef bool (*coop_idle_work_proc_t)(coop_tick_t remain, void *arg);
+
+/**
+ * Register idle-work routine @c proc, called by the scheduler instead of
+ * @ref coop_idle_cb() when all threads are idle. The routine is called
+ * repeatedly, as long as it reports performed work and no thread is ready to
+ * run, allowing deferrable work to be done in chunks without affecting threads
+ * wake-up latency.
+ *
+ * The registration is kept across the scheduler sessions.
+ *
+ * @param proc Idle-work routine. Pass @c NULL to unregister.
+ * @param arg User argument passed to @c proc.
+ *
+ * @note The routine is called on the scheduler stack (outside any thread
+ *     context), therefore shall not call library API intended to be called
+ *     from threads routines.
+ */
+void coop_idle_work(coop_idle_work_proc_t proc, void *arg);
+#endif
+
 /*
  * Platform specific callbacks specification section.
  */
 
 #if defined(CONFIG_OPT_IDLE) || \
     defined(CONFIG_OPT_YIELD_AFTER) || \
-    defined(CONFIG_OPT_WAIT)
+    defined(CONFIG_OPT_WAIT) || \
+    defined(CONFIG_OPT_STATS)
 /**
  * Get clock tick at the moment of the callback-routine call.
  */
@@ -212,6 +541,36 @@ coop_tick_t coop_tick_cb();
 void coop_idle_cb(coop_tick_t period);
 #endif
 
+#ifdef CONFIG_OPT_REMOTE_SPAWN
+/**
+ * Idle wake-up callback.
+ *
+ * Called by @ref coop_spawn_remote() (possibly from other OS thread or ISR) to
+ * finish pending @ref coop_idle_cb() call, so the scheduler may run the
+ * spawned thread. The callback shall not block, therefore shall be ISR (signal
+ * handler) safe. The default UNIX implementation writes to a non-blocking
+ * self-pipe the idle callback waits on.
+ */
+void coop_idle_wakeup_cb(void);
+#endif
+
+#ifdef CONFIG_UNIX_SYSCALL_WRAP
+/**
+ * UNIX only: wait for readiness of descriptors the threads are blocked on in
+ * the interposed system calls (see @ref CONFIG_UNIX_SYSCALL_WRAP). To be
+ * called by @ref coop_idle_cb(); the default implementation does so. Custom
+ * implementation of the idle callback not calling the routine doesn't finish
+ * the idle state on the descriptors readiness.
+ *
+ * @param bell_fd Additional descriptor finishing the wait when readable.
+ *     Pass -1 if not used.
+ * @param period Max number of clock ticks (msecs) to wait. 0 for infinite.
+ *
+ * @return true if @c bell_fd is readable.
+ */
+bool coop_wrap_idle_poll(int bell_fd, coop_tick_t period);
+#endif
+
 #ifdef CONFIG_OPT_WAIT
 /**
  * Switch current thread into wait-for-a-notification-signal state.
@@ -259,13 +618,16 @@ void coop_idle_cb(coop_tick_t period);
  * @see coop_wait() for additional notes.
  */
 coop_error_t coop_wait_cond(
-    int sem_id, coop_tick_t timeout, coop_predic_proc_t predic, void *cv);
+    int sem_id, coop_period_t timeout, coop_predic_proc_t predic, void *cv);
 
 /**
  * Send notification signal for a single thread waiting on @c sem_id.
  *
  * @note To be called from an arbitrary routine including ISR.
  *
+ * @note With @ref CONFIG_OPT_NESTED_SCHED the signal is passed to other
+ *     schedulers if no thread of the current one waits on @c sem_id.
+ *
  * @note While calling from ISR debug logs must be disabled or handled in
  *     a special way (see @ref CONFIG_DBG_LOG_CB_ALT) to avoid interrupt
  *     service related issues.
@@ -277,11 +639,658 @@ void coop_notify(int sem_id);
 /**
  * Send notification signal for all threads waiting on @c sem_id.
  *
+ * @note With @ref CONFIG_OPT_NESTED_SCHED the signal is passed to all running
+ *     schedulers.
+ *
  * @see coop_notify() for additional notes.
  */
 void coop_notify_all(int sem_id);
 #endif /* CONFIG_OPT_WAIT */
 
+#ifdef CONFIG_OPT_WAIT_POLL
+/**
+ * Wait for a poll-predicate to be satisfied.
+ *
+ * If @c predic(cv) returns @c false the current thread is switched into the
+ * waiting state. The predicate is evaluated by the scheduler on each its pass
+ * and before the system goes idle; the thread is switched to running state
+ * when the predicate returns @c true. The routine is intended for conditions
+ * changed outside of the threads (e.g. by other processes), which can't be
+ * signalled by @ref coop_notify().
+ *
+ * @param predic Poll-predicate routine. Must be cheap to evaluate.
+ * @param cv User argument passed to @c predic.
+ * @param timeout A timeout value the thread will wait for the predicate
+ *     before the timeout will be reported. Pass 0 for infinite wait.
+ *
+ * @return COOP_SUCCESS The predicate is satisfied.
+ * @return COOP_ERR_TIMEOUT Timeout reached.
+ *
+ * @note To be called from the thread routine only.
+ *
+ * @note The predicate is not evaluated while the system is idle. If the
+ *     condition is changed while the system is idle, pending
+ *     @ref coop_idle_cb() call shall be finished by the party changing it
+ *     (as done by the inter-process channels, see @ref coop_chan_send()).
+ */
+coop_error_t coop_wait_poll(
+    coop_predic_proc_t predic, void *cv, coop_period_t timeout);
+#endif
+
+#ifdef CONFIG_OPT_CHAN
+/**
+ * Create inter-process channel @c name for receiving messages.
+ *
+ * Each process using channels owns a doorbell (futex word in a shared memory
+ * segment) the peers ring after sending or releasing a message. Pending
+ * @ref coop_idle_cb() call is finished by the doorbell, so a thread waiting
+ * for the channel is woken-up with no polling.
+ *
+ * @param ch Channel to initialize.
+ * @param name POSIX shared memory segment name of the channel (e.g.
+ *     "/chan"). Shall be valid until the channel is closed.
+ * @param msg_sz Message size.
+ * @param msgs_n Channel capacity (number of messages). Must be a power of 2.
+ *
+ * @return COOP_SUCCESS Function finished with success.
+ * @return COOP_ERR_INV_ARG Invalid argument, the segment couldn't be
+ *     created or the existing one is still used by a live sending process
+ *     (which would be left with an orphaned segment).
+ *
+ * @note The routine is implemented by the UNIX platform module.
+ */
+coop_error_t coop_chan_create(
+    coop_chan_t *ch, const char *name, size_t msg_sz, size_t msgs_n);
+
+/**
+ * Open inter-process channel @c name, created by the receiving process, for
+ * sending messages.
+ *
+ * @return COOP_SUCCESS Function finished with success.
+ * @return COOP_ERR_INV_ARG Invalid argument, the channel doesn't exist, its
+ *     segment is malformed or already opened by another live sender (the
+ *     channel is a single-producer one).
+ */
+coop_error_t coop_chan_open(coop_chan_t *ch, const char *name);
+
+/**
+ * Close the channel. Channel segment is removed by the receiving side.
+ */
+void coop_chan_close(coop_chan_t *ch);
+
+/**
+ * Get the channel slot for the next message to send. If the channel is full
+ * the current thread is switched into the waiting state until the receiver
+ * releases a message. The sender fills the message in place and sends it by
+ * @ref coop_chan_send().
+ *
+ * @param ch Channel opened for sending.
+ * @param msg Pointer to the message slot.
+ * @param timeout A timeout value the thread will wait for a free slot before
+ *     the timeout will be reported. Pass 0 for infinite wait.
+ *
+ * @return COOP_SUCCESS Function finished with success.
+ * @return COOP_ERR_TIMEOUT Timeout reached.
+ *
+ * @note To be called from the thread routine only.
+ */
+coop_error_t coop_chan_claim(
+    coop_chan_t *ch, void **msg, coop_period_t timeout);
+
+/**
+ * Send the message prepared in the slot returned by @ref coop_chan_claim()
+ * and ring the receiving process doorbell.
+ */
+void coop_chan_send(coop_chan_t *ch);
+
+/**
+ * Receive a message. If the channel is empty the current thread is switched
+ * into the waiting state until a message is sent. The message is read in
+ * place and shall be released by @ref coop_chan_release() after processing.
+ *
+ * @param ch Channel created for receiving.
+ * @param msg Pointer to the received message.
+ * @param timeout A timeout value the thread will wait for a message before
+ *     the timeout will be reported. Pass 0 for infinite wait.
+ *
+ * @return COOP_SUCCESS Function finished with success.
+ * @return COOP_ERR_TIMEOUT Timeout reached.
+ *
+ * @note To be called from the thread routine only.
+ */
+coop_error_t coop_chan_recv(
+    coop_chan_t *ch, const void **msg, coop_period_t timeout);
+
+/**
+ * Release the message returned by @ref coop_chan_recv() and ring the sending
+ * process doorbell.
+ */
+void coop_chan_release(coop_chan_t *ch);
+#endif /* CONFIG_OPT_CHAN */
+
+#ifdef CONFIG_OPT_MUTEX
+/**
+ * Lock a mutex.
+ *
+ * If the mutex is owned by other thread the calling thread is switched into
+ * the waiting state. Waiting threads are queued in the FIFO order and the
+ * mutex ownership is passed directly by @ref coop_mutex_unlock() to the first
+ * waiting thread. Therefore neither a newly arriving thread nor the unlocking
+ * thread may barge-in and take the mutex before threads which are already
+ * waiting for it. Waiting time is bounded by the sum of critical sections of
+ * the owner and the threads queued before.
+ *
+ * @param mtx Mutex to lock.
+ * @param timeout A timeout value the thread will wait for the mutex before
+ *     the timeout will be reported. Pass 0 for infinite wait.
+ *
+ * @return COOP_SUCCESS The mutex is locked by the calling thread.
+ * @return COOP_ERR_TIMEOUT Timeout reached.
+ * @return COOP_ERR_INV_ARG The mutex is already owned by the calling thread
+ *     (the mutex is not recursive).
+ *
+ * @note To be called from the thread routine only.
+ *
+ * @note Thread owning a mutex must not terminate until unlocking it.
+ */
+coop_error_t coop_mutex_lock(coop_mutex_t *mtx, coop_period_t timeout);
+
+/**
+ * Try to lock a mutex without waiting.
+ *
+ * @return true The mutex is locked by the calling thread.
+ * @return false The mutex is owned by other or the calling thread.
+ *
+ * @note To be called from the thread routine only.
+ */
+bool coop_mutex_trylock(coop_mutex_t *mtx);
+
+/**
+ * Unlock a mutex owned by the calling thread. If there are threads waiting
+ * for the mutex, its ownership is passed to the first of them.
+ *
+ * @return COOP_SUCCESS Function finished with success.
+ * @return COOP_ERR_INV_ARG The mutex is not owned by the calling thread.
+ *
+ * @note To be called from the thread routine only.
+ */
+coop_error_t coop_mutex_unlock(coop_mutex_t *mtx);
+#endif /* CONFIG_OPT_MUTEX */
+
+#ifdef CONFIG_OPT_WAIT_ADDR
+/**
+ * Wait on an address (futex-like wait).
+ *
+ * If @c *addr is equal to @c expected the current thread is switched into
+ * wait-for-a-notification-signal state, sent by @ref coop_wake_addr() for the
+ * same address. Otherwise the routine returns immediately. The address plays
+ * a role of @c sem_id for @ref coop_wait() and shall be used as a basis for
+ * building synchronization primitives with no need to coordinate allocation
+ * of semaphore ids across the system.
+ *
+ * @param addr Waiting address.
+ * @param expected Expected value under @c addr.
+ * @param timeout A timeout value the thread will wait for a notification
+ *     before the timeout will be reported. Pass 0 for infinite wait.
+ *
+ * @return COOP_SUCCESS Notification signal received or @c *addr is not equal
+ *     to @c expected.
+ * @return COOP_ERR_TIMEOUT Timeout reached.
+ *
+ * @note To be called from the thread routine only.
+ */
+coop_error_t coop_wait_addr(
+    const int *addr, int expected, coop_period_t timeout);
+
+/**
+ * Send notification signal for threads waiting on @c addr.
+ *
+ * @param addr Waiting address.
+ * @param n Max number of threads to notify. Pass 0 to notify all waiting
+ *     threads.
+ *
+ * @return Number of notified threads.
+ *
+ * @note Not to be called from ISR.
+ */
+unsigned coop_wake_addr(const void *addr, unsigned n);
+#endif /* CONFIG_OPT_WAIT_ADDR */
+
+#ifdef CONFIG_OPT_RING
+/**
+ * Initialize ring buffer.
+ *
+ * @param ring Ring buffer to initialize.
+ * @param buf Ring buffer memory.
+ * @param size Ring buffer size. Must be a power of 2, not greater than 256.
+ *     Note, the ring may contain at most @c size-1 bytes.
+ *
+ * @return COOP_SUCCESS Function finished with success.
+ * @return COOP_ERR_INV_ARG Invalid argument.
+ */
+coop_error_t coop_ring_init(coop_ring_t *ring, unsigned char *buf, size_t size);
+
+/**
+ * Put a byte into the ring buffer.
+ *
+ * The routine marks the scheduler with pending ring data, therefore the system
+ * doesn't enter the idle state (via @ref coop_idle_cb()) and the thread waiting
+ * on the ring (see @ref coop_ring_get()) is switched to running state during
+ * the nearest scheduler pass.
+ *
+ * @return true The byte has been put.
+ * @return false The ring is full.
+ *
+ * @note The routine is intended to be called by the ring producer, which is
+ *     an ISR or a thread routine.
+ */
+bool coop_ring_put(coop_ring_t *ring, unsigned char c);
+
+/**
+ * Get a byte from the ring buffer. If the ring is empty the current thread is
+ * switched into the waiting state until a byte is put into the ring.
+ *
+ * @param ring Ring buffer.
+ * @param c Byte got from the ring.
+ * @param timeout A timeout value the thread will wait for the ring data
+ *     before the timeout will be reported. Pass 0 for infinite wait.
+ *
+ * @return COOP_SUCCESS Function finished with success.
+ * @return COOP_ERR_TIMEOUT Timeout reached.
+ *
+ * @note To be called from the (single) ring consumer thread routine only.
+ */
+coop_error_t coop_ring_get(
+    coop_ring_t *ring, unsigned char *c, coop_period_t timeout);
+#endif /* CONFIG_OPT_RING */
+
+#ifdef CONFIG_OPT_BCAST
+/**
+ * Initialize broadcast ring.
+ *
+ * @param bc Broadcast ring to initialize.
+ * @param buf Ring buffer memory of @c elems_n elements of @c elem_sz size.
+ * @param elem_sz Element size.
+ * @param elems_n Ring buffer size (number of elements). Must be a power of 2,
+ *     not less than 2. Note, at most @c elems_n-1 latest elements may be read
+ *     by the subscribers.
+ *
+ * @return COOP_SUCCESS Function finished with success.
+ * @return COOP_ERR_INV_ARG Invalid argument.
+ */
+coop_error_t coop_bcast_init(
+    coop_bcast_t *bc, void *buf, size_t elem_sz, size_t elems_n);
+
+/**
+ * Subscribe to the broadcast ring. The subscriber will read elements
+ * published after the subscription.
+ *
+ * @param bc Broadcast ring.
+ * @param sub Subscriber's cursor to initialize.
+ */
+void coop_bcast_subscribe(const coop_bcast_t *bc, coop_bcast_sub_t *sub);
+
+/**
+ * Get the ring slot for the next element to be published. The producer fills
+ * the element in place and publishes it by @ref coop_bcast_publish().
+ */
+void *coop_bcast_claim(coop_bcast_t *bc);
+
+/**
+ * Publish the element prepared in the slot returned by @ref coop_bcast_claim().
+ * Only the subscribers waiting for the element (see @ref coop_bcast_get()) are
+ * switched to running state, other subscribers are not affected.
+ *
+ * @note To be called by the (single) ring producer, which is a thread routine.
+ *     Not to be called from ISR.
+ */
+void coop_bcast_publish(coop_bcast_t *bc);
+
+/**
+ * Get the next element from the broadcast ring for subscriber @c sub. If the
+ * subscriber has read all published elements the current thread is switched
+ * into the waiting state until the next element is published.
+ *
+ * If the subscriber lags behind the producer by more than the ring size - 1,
+ * the overwritten elements are skipped and accounted as overruns (see
+ * @ref coop_bcast_overruns()).
+ *
+ * @param bc Broadcast ring.
+ * @param sub Subscriber's cursor.
+ * @param elem Pointer to the element in the ring buffer. The element is valid
+ *     until the calling thread passes the control to the scheduler (yields,
+ *     idles or waits).
+ * @param timeout A timeout value the thread will wait for the next element
+ *     before the timeout will be reported. Pass 0 for infinite wait.
+ *
+ * @return COOP_SUCCESS Function finished with success.
+ * @return COOP_ERR_TIMEOUT Timeout reached.
+ *
+ * @note To be called from the subscriber thread routine only.
+ */
+coop_error_t coop_bcast_get(coop_bcast_t *bc,
+    coop_bcast_sub_t *sub, const void **elem, coop_period_t timeout);
+
+/**
+ * Get number of elements lost by subscriber @c sub due to the ring overruns
+ * (slow subscriber detection).
+ */
+unsigned long coop_bcast_overruns(const coop_bcast_sub_t *sub);
+#endif /* CONFIG_OPT_BCAST */
+
+#ifdef CONFIG_OPT_STATS
+/**
+ * Current thread index; see @ref coop_thread_stats().
+ */
+# define COOP_CUR_THRD ((unsigned)-1)
+
+/**
+ * Thread statistics.
+ */
+typedef struct
+{
+    /** Thread name. */
+    const char *name;
+
+    /** Thread state name ("NEW", "RUN", "IDLE", "WAIT"). */
+    const char *state;
+
+    /** Number of clock ticks the thread has been running for. */
+    coop_tick_t run_ticks;
+
+    /** Number of switches into the thread. */
+    unsigned long switch_n;
+
+# if defined(CONFIG_OPT_STACK_WM) || defined(CONFIG_OPT_STACK_WM_SP)
+    /**
+     * Max stack usage water-mark; see @ref coop_stack_wm() or
+     * @ref coop_stack_wm_sp() if @ref CONFIG_OPT_STACK_WM is not enabled.
+     */
+    size_t stack_wm;
+# endif
+# ifdef CONFIG_OPT_WAIT
+    /** Semaphore id the thread is waiting on; valid in the waiting state
+        with @c wait_obj set to @c NULL. */
+    int wait_sem;
+
+    /** Object (mutex, broadcast ring, ring buffer, address, poll-predicate
+        argument) the thread is waiting on; @c NULL if not waiting or waiting
+        on a semaphore. */
+    const void *wait_obj;
+# endif
+# ifdef __COOP_MEM_STATS
+    /** Number of bytes currently allocated by the thread. */
+    size_t mem_cur;
+
+    /** Max number of bytes allocated by the thread at once (peak usage). */
+    size_t mem_peak;
+
+    /** Total number of bytes allocated by the thread during its lifetime. */
+    size_t mem_total;
+
+    /** Thread memory limit. 0 if not set. */
+    size_t mem_limit;
+# endif
+} coop_thrd_stats_t;
+
+/**
+ * Scheduler statistics.
+ */
+typedef struct
+{
+    /** Total number of switches into threads. */
+    unsigned long switch_n;
+
+    /** Number of system idle callback calls. */
+    unsigned long idle_n;
+
+    /** Number of occupied threads pool slots. */
+    unsigned busy_n;
+} coop_sched_stats_t;
+
+# ifdef __COOP_MEM_STATS
+/**
+ * Memory block owner; see @ref coop_mem_charge().
+ */
+typedef struct
+{
+    /** Owning thread id (pool slot index + 1); 0 if not accounted. */
+    unsigned thrd;
+
+    /** Owning thread generation; tells apart threads occupying the slot. */
+    unsigned gen;
+} coop_mem_owner_t;
+# endif
+
+/* statistics export buffer; see coop_stats.h */
+struct coop_stats_exp;
+#endif
+
+#ifdef CONFIG_OPT_PROF
+/**
+ * Contention profiler statistics of a synchronization point.
+ */
+typedef struct
+{
+    /** Semaphore id; valid if @c obj is @c NULL. */
+    int sem_id;
+
+    /** Synchronization object (mutex, ring buffer, address) or @c NULL for
+        a semaphore. */
+    const void *obj;
+
+    /** Number of waits. */
+    unsigned long waits;
+
+    /** Number of waits finished with timeout. */
+    unsigned long timeouts;
+
+    /** Number of notifications with no waiter (lost notifications). */
+    unsigned long lost;
+
+    /** Total number of clock ticks the threads were blocked for. */
+    coop_tick_t total;
+
+    /** Max number of clock ticks a thread was blocked for. */
+    coop_tick_t max;
+} coop_prof_stats_t;
+
+/**
+ * Get contention profiler report - profiled synchronization points sorted by
+ * the total blocked time (in descending order).
+ *
+ * Blocked time is measured from a thread switch into the waiting state up to
+ * its wake-up (notification or the thread resumption after timeout).
+ *
+ * @param report Report entries.
+ * @param n Max number of entries to report.
+ *
+ * @return Number of entries reported.
+ *
+ * @note Up to @ref CONFIG_PROF_ENTRIES synchronization points are profiled.
+ *     Synchronization points above the limit are not accounted.
+ */
+unsigned coop_prof_report(coop_prof_stats_t *report, unsigned n);
+
+/**
+ * Reset contention profiler statistics.
+ */
+void coop_prof_reset(void);
+#endif /* CONFIG_OPT_PROF */
+
+#ifdef CONFIG_OPT_RCU
+/*
+ * RCU (read-copy-update) support.
+ *
+ * A thread yielding to the scheduler can't hold any reference to RCU protected
+ * data, provided RCU read-side critical sections don't yield. Therefore each
+ * scheduler switch point (a thread yielding to the scheduler) constitutes
+ * a quiescent state for all threads and RCU read-side critical sections cost
+ * nothing.
+ */
+
+/**
+ * Enter RCU read-side critical section.
+ *
+ * @note RCU read-side critical section must not yield to the scheduler.
+ */
+# define coop_rcu_read_lock()
+
+/**
+ * Exit RCU read-side critical section.
+ */
+# define coop_rcu_read_unlock()
+
+/**
+ * RCU callback head. Intended to be embedded in the RCU protected data
+ * structure.
+ */
+typedef struct coop_rcu_head
+{
+    /** Next queued callback head. */
+    struct coop_rcu_head *next;
+
+    /** Callback routine. */
+    void (*func)(struct coop_rcu_head *head);
+} coop_rcu_head_t;
+
+/**
+ * Wait for RCU grace period to elapse, that is for all pre-existing RCU
+ * read-side critical sections to complete. The routine yields the current
+ * thread to the scheduler.
+ *
+ * @note To be called from the thread routine only.
+ */
+void coop_synchronize_rcu(void);
+
+/**
+ * Queue RCU callback @c func to be called after RCU grace period elapses.
+ * The callback is called by the scheduler at its nearest switch point, that is
+ * after the current thread yields to the scheduler or terminates.
+ *
+ * @param head Callback head; passed to the callback as its argument.
+ * @param func Callback routine.
+ *
+ * @note To be called from the thread routine only.
+ *
+ * @note The callback is called in the scheduler context and must not yield.
+ */
+void coop_call_rcu(coop_rcu_head_t *head, void (*func)(coop_rcu_head_t *head));
+#endif /* CONFIG_OPT_RCU */
+
+#ifdef CONFIG_OPT_MALLOC
+/**
+ * Allocate memory block of @c size bytes.
+ *
+ * Memory blocks are allocated in size classes (see @ref CONFIG_MALLOC_CLASSES)
+ * from a static memory arena (see @ref CONFIG_MALLOC_ARENA_SIZE). Freed blocks
+ * are kept on their size class free-list for reuse, therefore allocation and
+ * freeing take constant time and the arena doesn't fragment.
+ *
+ * @return Allocated memory block or @c NULL if there is no enough memory.
+ *
+ * @note Not to be called from ISR.
+ */
+void *coop_malloc(size_t size);
+
+/**
+ * Free memory block allocated by @ref coop_malloc(). @c NULL @c ptr is
+ * ignored.
+ *
+ * @note Not to be called from ISR.
+ */
+void coop_free(void *ptr);
+#endif /* CONFIG_OPT_MALLOC */
+
+#ifdef CONFIG_OPT_STATS
+/**
+ * Get thread statistics.
+ *
+ * @param thrd Thread index - threads pool slot index in range
+ *     [0..CONFIG_MAX_THREADS-1] or @ref COOP_CUR_THRD for the current thread.
+ * @param stats Thread statistics.
+ *
+ * @return COOP_SUCCESS Function finished with success.
+ * @return COOP_ERR_INV_ARG Invalid argument or no thread occupies the slot.
+ *
+ * @note If configured with @ref CONFIG_OPT_MALLOC (or
+ *     @ref CONFIG_UNIX_MALLOC_WRAP), memory is accounted for the thread
+ *     allocating it, regardless of the thread freeing it. Memory allocated
+ *     outside of thread routines is not accounted.
+ */
+coop_error_t coop_thread_stats(unsigned thrd, coop_thrd_stats_t *stats);
+
+/**
+ * Get scheduler statistics.
+ */
+void coop_sched_stats(coop_sched_stats_t *stats);
+
+/**
+ * Export live statistics into a buffer (usually a shared memory segment
+ * attached by an external viewer). The buffer layout is specified in
+ * coop_stats.h and its size shall be at least
+ * @c COOP_STATS_EXP_SIZE(CONFIG_MAX_THREADS).
+ *
+ * The scheduler updates the buffer under sequence lock at its switch points:
+ * statistics of the thread switched back to the scheduler are stored on each
+ * switch, the whole threads table is refreshed on a thread termination and
+ * before the system goes idle. Stack water-marks are updated on the whole
+ * table refresh only.
+ *
+ * @param exp Export buffer. Pass @c NULL to stop the export.
+ */
+void coop_stats_export(struct coop_stats_exp *exp);
+
+# ifdef __unix__
+/**
+ * Create POSIX shared memory segment @c name and export live statistics into
+ * it; see @ref coop_stats_export(). @c NULL @c name stands for
+ * @c COOP_STATS_SHM_NAME.
+ *
+ * @return COOP_SUCCESS Function finished with success.
+ * @return COOP_ERR_INV_ARG The segment couldn't be created.
+ */
+coop_error_t coop_stats_shm_export(const char *name);
+# endif
+
+# ifdef __COOP_MEM_STATS
+/**
+ * Set memory limit for the current thread. If @ref coop_malloc() (or other
+ * allocation charged by @ref coop_mem_charge()) called by the thread would
+ * exceed the limit, the allocation fails and @ref coop_mem_limit_cb() is
+ * called-back.
+ *
+ * @param limit Max number of bytes allocated by the thread at once. Pass 0 to
+ *     remove the limit.
+ *
+ * @note To be called from the thread routine only.
+ */
+void coop_thread_mem_limit(size_t limit);
+
+/**
+ * Charge @c size bytes allocated by a custom allocator (e.g. the platform heap
+ * wrappers, see @ref CONFIG_UNIX_MALLOC_WRAP) to the current thread, as done
+ * by @ref coop_malloc(). Memory allocated outside of thread routines is not
+ * accounted (@c owner->thrd is set to 0).
+ *
+ * @param size Number of allocated bytes.
+ * @param owner Memory owner to be passed to @ref coop_mem_uncharge().
+ *
+ * @return COOP_SUCCESS Function finished with success.
+ * @return COOP_ERR_LIMIT The thread memory limit would be exceeded;
+ *     @ref coop_mem_limit_cb() is called-back. The allocation shall fail.
+ */
+coop_error_t coop_mem_charge(size_t size, coop_mem_owner_t *owner);
+
+/**
+ * Credit @c size bytes charged by @ref coop_mem_charge() back to their owner,
+ * regardless of the freeing thread (and its scheduler, see
+ * @ref coop_sched_nested()). No-op if the owner has terminated.
+ */
+void coop_mem_uncharge(const coop_mem_owner_t *owner, size_t size);
+# endif
+#endif /* CONFIG_OPT_STATS */
+
 #ifdef CONFIG_OPT_STACK_WM
 /**
  * Get maximum stack usage water-mark for the current thread.
@@ -298,6 +1307,90 @@ void coop_notify_all(int sem_id);
 size_t coop_stack_wm();
 #endif
 
+#ifdef CONFIG_OPT_STACK_WM_SP
+/**
+ * Sample the current thread stack pointer for the stack pointer based
+ * water-mark. The stack pointer is sampled on each thread yield; the routine
+ * may be used as an additional instrumentation point (e.g. in deeply nested
+ * routines not yielding by themselves).
+ *
+ * @note To be called from the thread routine only.
+ */
+void coop_stack_sample();
+
+/**
+ * Get stack usage water-mark for the current thread based on the deepest
+ * stack pointer sampled (see @ref coop_stack_sample()).
+ *
+ * @return Stack usage water-mark in bytes. The value exceeding the thread
+ *     stack size indicates the stack overflow.
+ *
+ * @note Contrary to @ref coop_stack_wm() the stack doesn't need to be padded,
+ *     but the stack usage in between the samples is not accounted. The stack
+ *     pointer is approximated by an address of a local variable.
+ *
+ * @note To be called from the thread routine only.
+ */
+size_t coop_stack_wm_sp();
+#endif
+
+#ifdef CONFIG_OPT_STACK_LEARN
+/**
+ * Save the current thread stack usage water-mark as its learned stack size
+ * (see @ref coop_stack_learn_save_cb()). The learned size is saved on the
+ * thread termination; the routine is intended for threads running for the
+ * whole system lifetime.
+ *
+ * @note To be called from the thread routine only. The saving callback is
+ *     called on the thread stack.
+ */
+void coop_stack_learn_save();
+#endif
+
+#ifdef __COOP_MEM_STATS
+/**
+ * Thread memory limit exceeded callback.
+ *
+ * @param name Name of the thread exceeding its memory limit.
+ * @param size Number of bytes requested by the failed allocation.
+ */
+void coop_mem_limit_cb(const char *name, size_t size);
+#endif
+
+#ifdef CONFIG_OPT_STACK_CANARY
+/**
+ * Thread stack overflow callback. Called on the thread switch-out if the
+ * canary word placed beyond the thread stack far end was overwritten.
+ *
+ * @param name Name of the thread overflowing its stack.
+ *
+ * @note The memory adjacent to the thread stack is corrupted at this point,
+ *     therefore the routine is not expected to return.
+ */
+void coop_stack_overflow_cb(const char *name);
+#endif
+
+#ifdef CONFIG_OPT_STACK_LEARN
+/**
+ * Load learned stack size callback. Called by @ref coop_sched_thread() for
+ * a named thread scheduled with 0 stack size.
+ *
+ * @param name Thread name.
+ *
+ * @return Learned stack size of the thread or 0 if not known.
+ */
+size_t coop_stack_learn_load_cb(const char *name);
+
+/**
+ * Save learned stack size callback. The implementation is expected to persist
+ * the maximum of the saved sizes.
+ *
+ * @param name Thread name.
+ * @param stack_wm Thread stack usage water-mark.
+ */
+void coop_stack_learn_save_cb(const char *name, size_t stack_wm);
+#endif
+
 #ifdef COOP_DEBUG
 /**
  * Debug message log callback.
@@ -318,5 +1411,8 @@ unsigned coop_test_get_cur_thrd();
 void coop_test_set_cur_thrd(unsigned cur_thrd);
 void *coop_test_get_stack(unsigned thrd);
 void coop_test_set_stack(unsigned thrd, void *stack);
+size_t coop_test_get_stack_sz(unsigned thrd);
+unsigned coop_test_get_hole_n();
+bool coop_test_check_invariants();
 #endif
 #endif /* __COOP_THREADS_H__ */
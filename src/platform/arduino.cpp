@@ -66,5 +66,92 @@ void coop_idle_cb(coop_tick_t period)
 }
 #endif
 
+#if defined(CONFIG_OPT_REMOTE_SPAWN) && !defined(CONFIG_IDLE_WAKEUP_CB_ALT)
+/**
+ * Idle wake-up callback.
+ *
+ * Default implementation does nothing (the idle callback is finished after
+ * the idle period elapses).
+ */
+void coop_idle_wakeup_cb(void)
+{
+}
+#endif
+
+#if defined(__COOP_MEM_STATS) && !defined(CONFIG_MEM_LIMIT_CB_ALT)
+/**
+ * Thread memory limit exceeded callback.
+ *
+ * Default implementation does nothing (the failed allocation is reported
+ * by coop_malloc() return value).
+ */
+void coop_mem_limit_cb(const char *name, size_t size)
+{
+    (void)name;
+    (void)size;
+}
+#endif
+
+#if defined(CONFIG_OPT_STACK_CANARY) && !defined(CONFIG_STACK_OVERFLOW_CB_ALT)
+/**
+ * Thread stack overflow callback.
+ *
+ * Default implementation halts the platform (memory is already corrupted).
+ */
+void coop_stack_overflow_cb(const char *name)
+{
+    (void)name;
+    abort();
+}
+#endif
+
+#if defined(CONFIG_OPT_STACK_LEARN) && !defined(CONFIG_STACK_LEARN_CB_ALT)
+/*
+ * Default implementation doesn't persist the learned stack sizes (there is no
+ * non-volatile storage common for all platforms). Use
+ * CONFIG_STACK_LEARN_CB_ALT to provide EEPROM/NVS based implementation.
+ */
+
+/**
+ * Load learned stack size callback.
+ */
+size_t coop_stack_learn_load_cb(const char *name)
+{
+    (void)name;
+    return 0;
+}
+
+/**
+ * Save learned stack size callback.
+ */
+void coop_stack_learn_save_cb(const char *name, size_t stack_wm)
+{
+    (void)name;
+    (void)stack_wm;
+}
+#endif
+
+#ifdef CONFIG_ARDUINO_YIELD_HOOK
+# if defined(ARDUINO_ARCH_ESP8266) || defined(ARDUINO_ARCH_ESP32)
+#  error CONFIG_ARDUINO_YIELD_HOOK is not supported for the platform
+# endif
+/**
+ * Arduino core yield() hook.
+ *
+ * Called by Arduino's delay() while waiting. If called from a thread routine
+ * the thread is yielded to the scheduler, otherwise (e.g. delay() called by
+ * coop_idle_cb()) the hook does nothing as its original, weak counterpart.
+ *
+ * The delay is a busy-wait with the thread yielded (not idle), therefore the
+ * system idle state is not entered while any thread is delaying.
+ */
+void yield(void)
+{
+    if (coop_in_thread()) {
+        coop_yield();
+    }
+}
+#endif
+
 } /* extern "C" */
 #endif /* ARDUINO */
@@ -17,11 +17,35 @@
 #ifdef __unix__
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <unistd.h>
 
 #include "coop_threads.h"
 
+#if defined(CONFIG_OPT_REMOTE_SPAWN) && !defined(CONFIG_OPT_CHAN)
+# include <errno.h>
+# include <fcntl.h>
+# include <limits.h>
+# include <poll.h>
+#endif
+#if defined(CONFIG_OPT_STATS) || defined(CONFIG_OPT_CHAN)
+# include <fcntl.h>
+# include <sys/mman.h>
+#endif
+#ifdef CONFIG_OPT_STATS
+# include "coop_stats.h"
+#endif
+#ifdef CONFIG_OPT_CHAN
+# include <errno.h>
+# include <signal.h>
+# include <stdint.h>
+# include <linux/futex.h>
+# include <sys/stat.h>
+# include <sys/syscall.h>
+#endif
+
 #if defined(COOP_DEBUG) && !defined(CONFIG_DBG_LOG_CB_ALT)
 /**
  * Debug message log callback.
@@ -48,14 +72,626 @@ coop_tick_t coop_tick_cb()
 }
 #endif
 
+#ifdef CONFIG_OPT_CHAN
+/*
+ * Process doorbell rung by peer processes (and other OS threads) to finish
+ * the idle state. The doorbell is a futex word placed in BELL_SHM_FMT shared
+ * memory segment named after the process pid, so the peers may map it. Until
+ * the first channel is set up a private doorbell is used (unless the doorbell
+ * is rung by other OS threads, see _bell_init()).
+ */
+
+/** Doorbell segment name format. */
+# define BELL_SHM_FMT "/coop_bell.%ld"
+
+struct coop_bell
+{
+    /** Rings counter (futex word). */
+    volatile uint32_t seq;
+
+    /** The process is idle waiting on the doorbell. */
+    volatile uint32_t sleeping;
+};
+
+static struct coop_bell local_bell, *own_bell = &local_bell;
+
+/** Rings of the own doorbell seen by the idle callback. */
+static uint32_t bell_seen = 0;
+
+/** Number of channels using the doorbell segment. */
+static unsigned bell_users = 0;
+
+static void _bell_ring(struct coop_bell *bell)
+{
+    __atomic_add_fetch(&bell->seq, 1, __ATOMIC_SEQ_CST);
+
+    /* system call only if the process is idle */
+    if (__atomic_load_n(&bell->sleeping, __ATOMIC_SEQ_CST)) {
+        syscall(SYS_futex, &bell->seq, FUTEX_WAKE, 1, NULL, NULL, 0);
+    }
+}
+
+static inline void _bell_wait(coop_tick_t period)
+{
+    struct coop_bell *bell = own_bell;
+    struct timespec ts;
+
+    ts.tv_sec = period / 1000U;
+    ts.tv_nsec = (long)(period % 1000U) * 1000000L;
+
+    __atomic_store_n(&bell->sleeping, 1, __ATOMIC_SEQ_CST);
+    /* rings since the last idle are not lost */
+    if (__atomic_load_n(&bell->seq, __ATOMIC_SEQ_CST) == bell_seen) {
+        syscall(SYS_futex, &bell->seq, FUTEX_WAIT, bell_seen,
+            (period ? &ts : NULL), NULL, 0);
+    }
+    __atomic_store_n(&bell->sleeping, 0, __ATOMIC_SEQ_CST);
+    bell_seen = __atomic_load_n(&bell->seq, __ATOMIC_SEQ_CST);
+}
+#elif defined(CONFIG_OPT_REMOTE_SPAWN) && \
+    !(defined(CONFIG_IDLE_CB_ALT) && defined(CONFIG_IDLE_WAKEUP_CB_ALT))
+/*
+ * Idle doorbell rung by other OS threads (or signal handlers) to finish the
+ * idle state. The doorbell is a non-blocking self-pipe, so ringing it is
+ * lock-free and async-signal-safe. Rings not yet seen by the idle callback
+ * are kept in the pipe.
+ */
+static int idle_pipe[2] = {-1, -1};
+
+__attribute__((constructor))
+static void _idle_pipe_init(void)
+{
+    if (!pipe(idle_pipe)) {
+        fcntl(idle_pipe[0], F_SETFL, O_NONBLOCK);
+        fcntl(idle_pipe[1], F_SETFL, O_NONBLOCK);
+    }
+}
+#endif
+
 #ifndef CONFIG_IDLE_CB_ALT
 /**
  * System idle callback.
  */
 void coop_idle_cb(coop_tick_t period)
 {
+# if defined(CONFIG_OPT_CHAN)
+    _bell_wait(period);
+# elif !defined(CONFIG_OPT_REMOTE_SPAWN)
+#  ifdef CONFIG_UNIX_SYSCALL_WRAP
+    /* finished by the descriptors the threads are blocked on */
+    coop_wrap_idle_poll(-1, period);
+#  else
     /* ticks in msecs */
     usleep((useconds_t)period * 1000U);
+#  endif
+# else
+    char rings[32];
+#  ifdef CONFIG_UNIX_SYSCALL_WRAP
+    if (coop_wrap_idle_poll(idle_pipe[0], period))
+#  else
+    struct pollfd pfd;
+
+    pfd.fd = idle_pipe[0];
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    /* ticks in msecs */
+    if (poll(&pfd, 1, (!period ? -1 :
+        (period > INT_MAX ? INT_MAX : (int)period))) > 0)
+#  endif
+    {
+        /* consume the rings */
+        while (read(idle_pipe[0], rings, sizeof(rings)) > 0);
+    }
+# endif
+}
+#endif
+
+#if defined(CONFIG_OPT_REMOTE_SPAWN) && !defined(CONFIG_IDLE_WAKEUP_CB_ALT)
+/**
+ * Idle wake-up callback.
+ */
+void coop_idle_wakeup_cb(void)
+{
+# ifdef CONFIG_OPT_CHAN
+    _bell_ring(own_bell);
+# else
+    int err = errno;
+
+    /* full pipe means the rings are still pending */
+    if (write(idle_pipe[1], "", 1) < 0) {}
+    errno = err;
+# endif
+}
+#endif
+
+#if defined(__COOP_MEM_STATS) && !defined(CONFIG_MEM_LIMIT_CB_ALT)
+/**
+ * Thread memory limit exceeded callback.
+ */
+void coop_mem_limit_cb(const char *name, size_t size)
+{
+    fprintf(stderr, "Thread %s: memory limit exceeded while allocating "
+        "%lu bytes\n", (name ? name : "???"), (unsigned long)size);
 }
 #endif
+
+#if defined(CONFIG_OPT_STACK_CANARY) && !defined(CONFIG_STACK_OVERFLOW_CB_ALT)
+/**
+ * Thread stack overflow callback.
+ */
+void coop_stack_overflow_cb(const char *name)
+{
+    fprintf(stderr, "Thread %s: stack overflow\n", (name ? name : "???"));
+    abort();
+}
+#endif
+
+#if defined(CONFIG_OPT_STACK_LEARN) && !defined(CONFIG_STACK_LEARN_CB_ALT)
+/*
+ * Learned stack sizes are persisted in CONFIG_STACK_LEARN_FILE text file,
+ * a line per thread: "<stack size> <thread name>".
+ */
+
+/**
+ * Load learned stack size callback.
+ */
+size_t coop_stack_learn_load_cb(const char *name)
+{
+    char tname[64];
+    unsigned long sz, learned = 0;
+    FILE *f = fopen(CONFIG_STACK_LEARN_FILE, "r");
+
+    if (!f) return 0;
+
+    while (fscanf(f, "%lu %63[^\n]", &sz, tname) == 2) {
+        if (!strcmp(tname, name)) {
+            learned = sz;
+            break;
+        }
+    }
+    fclose(f);
+    return (size_t)learned;
+}
+
+/**
+ * Save learned stack size callback.
+ */
+void coop_stack_learn_save_cb(const char *name, size_t stack_wm)
+{
+    char tname[64], tmp_name[sizeof(CONFIG_STACK_LEARN_FILE) + 4];
+    unsigned long sz;
+    FILE *f, *tmp;
+
+    if (coop_stack_learn_load_cb(name) >= stack_wm) {
+        /* max already saved */
+        return;
+    }
+
+    /* rewrite the file with the updated entry */
+    snprintf(tmp_name, sizeof(tmp_name), "%s.tmp", CONFIG_STACK_LEARN_FILE);
+    if (!(tmp = fopen(tmp_name, "w"))) return;
+
+    if ((f = fopen(CONFIG_STACK_LEARN_FILE, "r")) != NULL)
+    {
+        while (fscanf(f, "%lu %63[^\n]", &sz, tname) == 2) {
+            if (strcmp(tname, name)) fprintf(tmp, "%lu %s\n", sz, tname);
+        }
+        fclose(f);
+    }
+    fprintf(tmp, "%lu %s\n", (unsigned long)stack_wm, name);
+
+    if (fclose(tmp) || rename(tmp_name, CONFIG_STACK_LEARN_FILE)) {
+        remove(tmp_name);
+    }
+}
+#endif
+
+#ifdef CONFIG_OPT_STATS
+coop_error_t coop_stats_shm_export(const char *name)
+{
+    const size_t size = COOP_STATS_EXP_SIZE(CONFIG_MAX_THREADS);
+    void *exp;
+    int fd;
+
+    if (!name) name = COOP_STATS_SHM_NAME;
+
+    if ((fd = shm_open(name, O_CREAT | O_RDWR, 0644)) < 0) {
+        return COOP_ERR_INV_ARG;
+    }
+    if (ftruncate(fd, (off_t)size) < 0) {
+        close(fd);
+        return COOP_ERR_INV_ARG;
+    }
+
+    exp = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (exp == MAP_FAILED) {
+        return COOP_ERR_INV_ARG;
+    }
+
+    coop_stats_export((struct coop_stats_exp*)exp);
+    return COOP_SUCCESS;
+}
+#endif
+
+#ifdef CONFIG_OPT_CHAN
+/** Channel segment magic ("COCH"). */
+# define CHAN_MAGIC 0x434f4348UL
+
+/**
+ * Channel segment header; followed by the messages ring.
+ */
+struct coop_chan_shm
+{
+    uint32_t magic;
+
+    /** Message size (aligned) and channel capacity. */
+    uint32_t msg_sz;
+    uint32_t msgs_n;
+
+    /** Receiving and sending processes pids; 0 if not attached. */
+    volatile int32_t rx_pid;
+    volatile int32_t tx_pid;
+
+    /** Write (sender) and read (receiver) sequences. */
+    volatile uint32_t head;
+    volatile uint32_t tail;
+
+    uint32_t res;
+};
+
+# define _CHAN_SIZE(_msg_sz, _msgs_n) \
+    (sizeof(struct coop_chan_shm) + (size_t)(_msg_sz) * (_msgs_n))
+
+/* message slot of sequence @c _seq */
+# define _CHAN_MSG(_shm, _seq) ((unsigned char*)((_shm) + 1) + \
+    ((_seq) & ((_shm)->msgs_n - 1)) * (_shm)->msg_sz)
+
+/**
+ * Map doorbell segment of process @c pid; create it if requested.
+ */
+static struct coop_bell *_bell_map(long pid, bool create)
+{
+    char name[32];
+    struct coop_bell *bell;
+    int fd;
+
+    snprintf(name, sizeof(name), BELL_SHM_FMT, pid);
+    if (create) {
+        /* segment left by a terminated process of the same pid */
+        shm_unlink(name);
+        fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    } else {
+        fd = shm_open(name, O_RDWR, 0);
+    }
+    if (fd < 0) {
+        return NULL;
+    }
+    if (create && ftruncate(fd, (off_t)sizeof(*bell)) < 0) {
+        close(fd);
+        shm_unlink(name);
+        return NULL;
+    }
+
+    bell = (struct coop_bell*)mmap(NULL, sizeof(*bell),
+        PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (bell == MAP_FAILED) {
+        if (create) shm_unlink(name);
+        return NULL;
+    }
+    return bell;
+}
+
+/**
+ * Remove the process doorbell segment.
+ */
+static void _bell_unlink(void)
+{
+    char name[32];
+
+    snprintf(name, sizeof(name), BELL_SHM_FMT, (long)getpid());
+    shm_unlink(name);
+}
+
+# ifdef CONFIG_OPT_REMOTE_SPAWN
+/*
+ * The doorbell may be rung by coop_idle_wakeup_cb() called by other OS threads
+ * at any time, therefore it's not switched while the process runs: the
+ * segment is mapped at the process startup and kept up to its exit. If the
+ * mapping fails the private doorbell is used and no channel may be set up.
+ */
+__attribute__((constructor))
+static void _bell_init(void)
+{
+    struct coop_bell *bell = _bell_map((long)getpid(), true);
+
+    if (bell) {
+        own_bell = bell;
+        atexit(_bell_unlink);
+    }
+}
+# endif
+
+/**
+ * Set up the process doorbell segment for a new channel.
+ */
+static bool _bell_get(void)
+{
+    if (own_bell == &local_bell) {
+# ifdef CONFIG_OPT_REMOTE_SPAWN
+        /* the segment couldn't be mapped (see _bell_init()) */
+        return false;
+# else
+        struct coop_bell *bell = _bell_map((long)getpid(), true);
+
+        if (!bell) return false;
+        own_bell = bell;
+        bell_seen = 0;
+# endif
+    }
+    bell_users++;
+    return true;
+}
+
+/**
+ * Release the process doorbell segment by a closed channel.
+ */
+static void _bell_put(void)
+{
+    if (bell_users && !--bell_users)
+    {
+# ifndef CONFIG_OPT_REMOTE_SPAWN
+        munmap(own_bell, sizeof(*own_bell));
+        own_bell = &local_bell;
+        bell_seen = local_bell.seq;
+        _bell_unlink();
+# endif
+    }
+}
+
+/**
+ * Peer process doorbell; mapped as soon as the peer is attached. The peer
+ * pid is re-validated on each call, so the doorbell of a re-attached peer
+ * process is mapped again.
+ */
+static struct coop_bell *_peer_bell(coop_chan_t *ch)
+{
+    long pid = (ch->name ?
+        __atomic_load_n(&ch->shm->tx_pid, __ATOMIC_ACQUIRE) :
+        __atomic_load_n(&ch->shm->rx_pid, __ATOMIC_ACQUIRE));
+
+    if (pid != ch->peer_pid)
+    {
+        if (ch->peer_bell) {
+            munmap(ch->peer_bell, sizeof(*ch->peer_bell));
+        }
+        ch->peer_bell = (pid ? _bell_map(pid, false) : NULL);
+        /* not yet created doorbell is mapped on the next call */
+        ch->peer_pid = (ch->peer_bell ? pid : 0);
+    }
+    return ch->peer_bell;
+}
+
+/**
+ * Check whether process @c pid attached to a channel is alive.
+ */
+static bool _pid_alive(long pid)
+{
+    return (pid > 0 && (!kill((pid_t)pid, 0) || errno == EPERM));
+}
+
+/**
+ * Check whether existing channel segment @c name is used by a live sender.
+ */
+static bool _chan_busy(const char *name)
+{
+    struct coop_chan_shm *shm;
+    struct stat st;
+    bool busy = false;
+    int fd;
+
+    if ((fd = shm_open(name, O_RDONLY, 0)) < 0) {
+        return false;
+    }
+    if (!fstat(fd, &st) && (size_t)st.st_size >= sizeof(*shm))
+    {
+        shm = (struct coop_chan_shm*)mmap(NULL, sizeof(*shm),
+            PROT_READ, MAP_SHARED, fd, 0);
+
+        if (shm != MAP_FAILED) {
+            busy = (__atomic_load_n(&shm->magic, __ATOMIC_ACQUIRE) ==
+                CHAN_MAGIC && _pid_alive(
+                    __atomic_load_n(&shm->tx_pid, __ATOMIC_ACQUIRE)));
+            munmap(shm, sizeof(*shm));
+        }
+    }
+    close(fd);
+    return busy;
+}
+
+static bool _chan_readable(void *cv)
+{
+    struct coop_chan_shm *shm = ((coop_chan_t*)cv)->shm;
+    return (__atomic_load_n(&shm->head, __ATOMIC_ACQUIRE) != shm->tail);
+}
+
+static bool _chan_writable(void *cv)
+{
+    struct coop_chan_shm *shm = ((coop_chan_t*)cv)->shm;
+    return (shm->head - __atomic_load_n(&shm->tail, __ATOMIC_ACQUIRE) <
+        shm->msgs_n);
+}
+
+coop_error_t coop_chan_create(
+    coop_chan_t *ch, const char *name, size_t msg_sz, size_t msgs_n)
+{
+    struct coop_chan_shm *shm;
+    size_t size;
+    int fd;
+
+    if (!ch || !name || !msg_sz || !msgs_n || (msgs_n & (msgs_n - 1))) {
+        return COOP_ERR_INV_ARG;
+    }
+
+    /* messages slots are aligned */
+    msg_sz = (msg_sz + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+    size = _CHAN_SIZE(msg_sz, msgs_n);
+
+    /* a sender attached to the existing segment would write to an orphaned
+       one after its replacement */
+    if (_chan_busy(name) || !_bell_get()) {
+        return COOP_ERR_INV_ARG;
+    }
+    /* segment left by a previous session is replaced by a new (zeroed) one */
+    shm_unlink(name);
+    if ((fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644)) < 0) {
+        _bell_put();
+        return COOP_ERR_INV_ARG;
+    }
+    if (ftruncate(fd, (off_t)size) < 0) {
+        close(fd);
+        shm_unlink(name);
+        _bell_put();
+        return COOP_ERR_INV_ARG;
+    }
+
+    shm = (struct coop_chan_shm*)mmap(NULL, size,
+        PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (shm == MAP_FAILED) {
+        shm_unlink(name);
+        _bell_put();
+        return COOP_ERR_INV_ARG;
+    }
+
+    shm->msg_sz = (uint32_t)msg_sz;
+    shm->msgs_n = (uint32_t)msgs_n;
+    shm->rx_pid = (int32_t)getpid();
+    /* the channel is ready to be opened */
+    __atomic_store_n(&shm->magic, CHAN_MAGIC, __ATOMIC_RELEASE);
+
+    ch->shm = shm;
+    ch->size = size;
+    ch->peer_bell = NULL;
+    ch->peer_pid = 0;
+    ch->name = name;
+    return COOP_SUCCESS;
+}
+
+coop_error_t coop_chan_open(coop_chan_t *ch, const char *name)
+{
+    struct coop_chan_shm *shm;
+    struct stat st;
+    int32_t tx_pid;
+    int fd;
+
+    if (!ch || !name) {
+        return COOP_ERR_INV_ARG;
+    }
+    if ((fd = shm_open(name, O_RDWR, 0)) < 0) {
+        return COOP_ERR_INV_ARG;
+    }
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(*shm)) {
+        close(fd);
+        return COOP_ERR_INV_ARG;
+    }
+
+    shm = (struct coop_chan_shm*)mmap(NULL, (size_t)st.st_size,
+        PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (shm == MAP_FAILED) {
+        return COOP_ERR_INV_ARG;
+    }
+    /* stale or malformed segment shall not be accessed past the mapping */
+    if (__atomic_load_n(&shm->magic, __ATOMIC_ACQUIRE) != CHAN_MAGIC ||
+        !shm->msg_sz || !shm->msgs_n || (shm->msgs_n & (shm->msgs_n - 1)) ||
+        shm->msgs_n > ((size_t)st.st_size - sizeof(*shm)) / shm->msg_sz ||
+        !_bell_get())
+    {
+        munmap(shm, (size_t)st.st_size);
+        return COOP_ERR_INV_ARG;
+    }
+
+    /*
+     * Single-producer ring: the channel is claimed by the sender unless
+     * already attached by another live one. The sender doorbell may be rung
+     * by the receiver since then.
+     */
+    tx_pid = __atomic_load_n(&shm->tx_pid, __ATOMIC_ACQUIRE);
+    if (_pid_alive(tx_pid) || !__atomic_compare_exchange_n(&shm->tx_pid,
+        &tx_pid, (int32_t)getpid(), false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    {
+        munmap(shm, (size_t)st.st_size);
+        _bell_put();
+        return COOP_ERR_INV_ARG;
+    }
+
+    ch->shm = shm;
+    ch->size = (size_t)st.st_size;
+    ch->peer_bell = NULL;
+    ch->peer_pid = 0;
+    ch->name = NULL;
+    return COOP_SUCCESS;
+}
+
+void coop_chan_close(coop_chan_t *ch)
+{
+    if (!ch->shm) return;
+
+    if (ch->peer_bell) {
+        munmap(ch->peer_bell, sizeof(*ch->peer_bell));
+    }
+    if (ch->name) {
+        shm_unlink(ch->name);
+    } else {
+        __atomic_store_n(&ch->shm->tx_pid, 0, __ATOMIC_RELEASE);
+    }
+    munmap(ch->shm, ch->size);
+    _bell_put();
+
+    ch->shm = NULL;
+    ch->peer_bell = NULL;
+    ch->peer_pid = 0;
+}
+
+coop_error_t coop_chan_claim(
+    coop_chan_t *ch, void **msg, coop_period_t timeout)
+{
+    if (coop_wait_poll(_chan_writable, ch, timeout) != COOP_SUCCESS) {
+        return COOP_ERR_TIMEOUT;
+    }
+
+    *msg = _CHAN_MSG(ch->shm, ch->shm->head);
+    return COOP_SUCCESS;
+}
+
+void coop_chan_send(coop_chan_t *ch)
+{
+    __atomic_store_n(&ch->shm->head, ch->shm->head + 1, __ATOMIC_RELEASE);
+    if (_peer_bell(ch)) _bell_ring(ch->peer_bell);
+}
+
+coop_error_t coop_chan_recv(
+    coop_chan_t *ch, const void **msg, coop_period_t timeout)
+{
+    if (coop_wait_poll(_chan_readable, ch, timeout) != COOP_SUCCESS) {
+        return COOP_ERR_TIMEOUT;
+    }
+
+    *msg = _CHAN_MSG(ch->shm, ch->shm->tail);
+    return COOP_SUCCESS;
+}
+
+void coop_chan_release(coop_chan_t *ch)
+{
+    __atomic_store_n(&ch->shm->tail, ch->shm->tail + 1, __ATOMIC_RELEASE);
+    if (_peer_bell(ch)) _bell_ring(ch->peer_bell);
+}
+#endif /* CONFIG_OPT_CHAN */
 #endif /* __unix__ */
@@ -0,0 +1,563 @@
+/*
+ * Copyright (c) 2021 Piotr Stolarz
+ * Lightweight cooperative threads library
+ *
+ * Distributed under the 2-clause BSD License (the License)
+ * see accompanying file LICENSE for details.
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the License for more information.
+ */
+
+/*
+ * UNIX platform: blocking system calls interposition layer.
+ *
+ * The layer makes legacy code calling blocking system calls cooperative while
+ * called from a thread routine. The calls are interposed via the linker
+ * wrapping, therefore the final image shall be linked with the following
+ * linker flags:
+ *
+ * -Wl,--wrap=sleep,--wrap=usleep,--wrap=nanosleep,--wrap=read,--wrap=write,
+ * --wrap=connect,--wrap=accept,--wrap=poll
+ *
+ * Sleeps are turned into coop_idle() calls. Blocking I/O on file descriptors
+ * switches the thread into the waiting state up to the descriptors readiness.
+ * The readiness is checked by the scheduler on each its pass (poll-predicate)
+ * and waited for by the idle callback, which poll()s all the descriptors the
+ * threads are blocked on with the idle period as timeout (see
+ * coop_wrap_idle_poll()). Non-blocking descriptors and calls made outside of
+ * thread routines (e.g. by the platform callbacks) are passed untouched to
+ * the original system calls.
+ *
+ * NOTE: Clock ticks are assumed to be milliseconds (as implemented by the
+ * default coop_tick_cb() for the platform).
+ *
+ * The platform heap routines may be interposed as well (see
+ * CONFIG_UNIX_MALLOC_WRAP), to account application allocations made by thread
+ * routines to the allocating threads (see coop_thread_stats()):
+ *
+ * -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free
+ *
+ * Accounted blocks are plain platform heap blocks, recorded in a table kept
+ * outside of them. Therefore the blocks may be passed to platform libraries
+ * reallocating or freeing them internally (e.g. getline(3), getdelim(3)). Such
+ * a block is no longer tracked: its charge remains with the owning thread up
+ * to the owner termination or the block address reuse by the wrappers, and its
+ * reallocated successor is not accounted.
+ *
+ * NOTE: Both layers treat calls made by other OS threads while a thread routine
+ * is running as made by the routine, therefore are intended for processes
+ * calling the interposed routines by the OS thread running the scheduler only.
+ */
+
+#ifdef __unix__
+#include "coop_threads.h"
+
+#ifdef CONFIG_UNIX_SYSCALL_WRAP
+#include <alloca.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef CONFIG_OPT_IDLE
+# error CONFIG_UNIX_SYSCALL_WRAP requires CONFIG_OPT_IDLE
+#endif
+#ifndef CONFIG_OPT_WAIT_POLL
+# error CONFIG_UNIX_SYSCALL_WRAP requires CONFIG_OPT_WAIT_POLL
+#endif
+#ifdef CONFIG_OPT_CHAN
+/* the process doorbell (futex) can't be waited together with descriptors */
+# error CONFIG_UNIX_SYSCALL_WRAP is incompatible with CONFIG_OPT_CHAN
+#endif
+
+unsigned int __real_sleep(unsigned int seconds);
+int __real_usleep(useconds_t usec);
+int __real_nanosleep(const struct timespec *req, struct timespec *rem);
+ssize_t __real_read(int fd, void *buf, size_t count);
+ssize_t __real_write(int fd, const void *buf, size_t count);
+int __real_connect(int sockfd, const struct sockaddr *addr, socklen_t addrlen);
+int __real_accept(int sockfd, struct sockaddr *addr, socklen_t *addrlen);
+int __real_poll(struct pollfd *fds, nfds_t nfds, int timeout);
+
+/**
+ * Idle the current thread for @c msecs milliseconds.
+ */
+static void _idle(unsigned long long msecs)
+{
+    if (!msecs) {
+        coop_yield();
+        return;
+    }
+
+#ifdef CONFIG_OPT_EXT_TICK
+    coop_idle(msecs);
+#else
+    while (msecs > 0) {
+        coop_tick_t period =
+            (msecs > COOP_MAX_PERIOD ? COOP_MAX_PERIOD : (coop_tick_t)msecs);
+
+        coop_idle(period);
+        msecs -= period;
+    }
+#endif
+}
+
+/**
+ * Thread waiting for descriptors readiness (placed on the thread stack).
+ */
+struct fd_waiter
+{
+    struct pollfd *fds;
+    nfds_t nfds;
+
+    struct fd_waiter *prev;
+    struct fd_waiter *next;
+};
+
+/** Threads waiting for descriptors readiness. */
+static struct fd_waiter *waiters = NULL;
+
+/** Total number of descriptors the threads are waiting for. */
+static nfds_t waiters_nfds = 0;
+
+/**
+ * Poll-predicate: waited descriptors are ready (or failed).
+ */
+static bool _fds_ready(void *cv)
+{
+    struct fd_waiter *w = (struct fd_waiter*)cv;
+    return (__real_poll(w->fds, w->nfds, 0) != 0);
+}
+
+/**
+ * poll(2) equivalent switching the current thread into the waiting state while
+ * no descriptor is ready.
+ */
+static int _poll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+    int ret;
+    struct fd_waiter w;
+
+    if ((ret = __real_poll(fds, nfds, 0)) != 0 || !timeout) {
+        return ret;
+    }
+
+    w.fds = fds;
+    w.nfds = nfds;
+    w.prev = NULL;
+    w.next = waiters;
+    if (waiters) waiters->prev = &w;
+    waiters = &w;
+    waiters_nfds += nfds;
+
+    if (coop_wait_poll(_fds_ready, &w,
+        (timeout < 0 ? 0 : (coop_period_t)timeout)) == COOP_SUCCESS)
+    {
+        ret = __real_poll(fds, nfds, 0);
+    }
+
+    if (w.next) w.next->prev = w.prev;
+    if (w.prev) {
+        w.prev->next = w.next;
+    } else {
+        waiters = w.next;
+    }
+    waiters_nfds -= nfds;
+
+    return ret;
+}
+
+bool coop_wrap_idle_poll(int bell_fd, coop_tick_t period)
+{
+    struct fd_waiter *w;
+    struct pollfd *fds = (struct pollfd*)
+        alloca((waiters_nfds + 1) * sizeof(*fds));
+    nfds_t n = 0;
+
+    fds[n].fd = bell_fd;
+    fds[n].events = POLLIN;
+    fds[n].revents = 0;
+    n++;
+
+    for (w = waiters; w; w = w->next) {
+        memcpy(&fds[n], w->fds, w->nfds * sizeof(*fds));
+        n += w->nfds;
+    }
+
+    /* ticks in msecs; negative descriptors are ignored */
+    if (__real_poll(fds, n, (!period ? -1 :
+        (period > INT_MAX ? INT_MAX : (int)period))) <= 0)
+    {
+        return false;
+    }
+    return (fds[0].revents != 0);
+}
+
+/**
+ * Wait for @c events on blocking descriptor @c fd.
+ *
+ * Return true if the descriptor was blocking and has been waited for.
+ */
+static bool _wait_fd(int fd, short events)
+{
+    struct pollfd pfd;
+    int flags = fcntl(fd, F_GETFL);
+
+    if (flags == -1 || (flags & O_NONBLOCK)) {
+        return false;
+    }
+
+    pfd.fd = fd;
+    pfd.events = events;
+    pfd.revents = 0;
+    _poll(&pfd, 1, -1);
+
+    return true;
+}
+
+unsigned int __wrap_sleep(unsigned int seconds)
+{
+    if (!coop_in_thread()) {
+        return __real_sleep(seconds);
+    }
+
+    _idle(seconds * 1000ULL);
+    return 0;
+}
+
+int __wrap_usleep(useconds_t usec)
+{
+    if (!coop_in_thread()) {
+        return __real_usleep(usec);
+    }
+
+    _idle((usec + 999ULL) / 1000U);
+    return 0;
+}
+
+int __wrap_nanosleep(const struct timespec *req, struct timespec *rem)
+{
+    if (!coop_in_thread()) {
+        return __real_nanosleep(req, rem);
+    }
+
+    if (!req || req->tv_sec < 0 || req->tv_nsec < 0 || req->tv_nsec > 999999999)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    _idle(req->tv_sec * 1000ULL + (req->tv_nsec + 999999ULL) / 1000000U);
+    if (rem) {
+        rem->tv_sec = 0;
+        rem->tv_nsec = 0;
+    }
+    return 0;
+}
+
+ssize_t __wrap_read(int fd, void *buf, size_t count)
+{
+    if (coop_in_thread()) {
+        _wait_fd(fd, POLLIN);
+    }
+    return __real_read(fd, buf, count);
+}
+
+ssize_t __wrap_write(int fd, const void *buf, size_t count)
+{
+    if (coop_in_thread()) {
+        _wait_fd(fd, POLLOUT);
+    }
+    return __real_write(fd, buf, count);
+}
+
+int __wrap_connect(int sockfd, const struct sockaddr *addr, socklen_t addrlen)
+{
+    int ret, err, flags;
+    socklen_t err_len = sizeof(err);
+    struct pollfd pfd;
+
+    if (!coop_in_thread() || (flags = fcntl(sockfd, F_GETFL)) == -1 ||
+        (flags & O_NONBLOCK))
+    {
+        return __real_connect(sockfd, addr, addrlen);
+    }
+
+    /* connect in non-blocking mode and wait for the connection result */
+    fcntl(sockfd, F_SETFL, flags | O_NONBLOCK);
+
+    ret = __real_connect(sockfd, addr, addrlen);
+    if (ret == -1 && errno == EINPROGRESS)
+    {
+        pfd.fd = sockfd;
+        pfd.events = POLLOUT;
+        pfd.revents = 0;
+        _poll(&pfd, 1, -1);
+
+        if (getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &err, &err_len) == -1) {
+            err = errno;
+        }
+        if (err) {
+            errno = err;
+        } else {
+            ret = 0;
+        }
+    }
+
+    err = errno;
+    fcntl(sockfd, F_SETFL, flags);
+    errno = err;
+
+    return ret;
+}
+
+int __wrap_accept(int sockfd, struct sockaddr *addr, socklen_t *addrlen)
+{
+    if (coop_in_thread()) {
+        _wait_fd(sockfd, POLLIN);
+    }
+    return __real_accept(sockfd, addr, addrlen);
+}
+
+int __wrap_poll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+    if (!coop_in_thread() || !timeout) {
+        return __real_poll(fds, nfds, timeout);
+    }
+    return _poll(fds, nfds, timeout);
+}
+#endif /* CONFIG_UNIX_SYSCALL_WRAP */
+
+#ifdef CONFIG_UNIX_MALLOC_WRAP
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+/**
+ * Accounted heap block record. The records are kept outside of the blocks
+ * (which are plain platform heap blocks), so the blocks may be reallocated or
+ * freed by the platform libraries directly (e.g. by getline(3)).
+ */
+struct heap_blk
+{
+    void *ptr;
+    size_t size;
+    coop_mem_owner_t owner;
+};
+
+/** Initial size of the records table. */
+#define HEAP_BLKS_INIT 64U
+
+/**
+ * Accounted heap blocks records: hash table (open addressing with linear
+ * probing) keyed by the block address. Allocated by the platform heap
+ * directly.
+ */
+static struct heap_blk *blks = NULL;
+
+/** Table capacity (power of 2). */
+static size_t blks_cap = 0;
+
+/** Number of records in the table. */
+static size_t blks_n = 0;
+
+static inline size_t _blk_hash(const void *ptr)
+{
+    return (size_t)((((uintptr_t)ptr >> 4) * 2654435761UL) & (blks_cap - 1));
+}
+
+/**
+ * Find record of accounted block @c ptr. NULL if not found.
+ */
+static struct heap_blk *_blk_find(const void *ptr)
+{
+    size_t i;
+
+    if (!blks_n) return NULL;
+
+    for (i = _blk_hash(ptr); blks[i].ptr; i = (i + 1) & (blks_cap - 1)) {
+        if (blks[i].ptr == ptr) return &blks[i];
+    }
+    return NULL;
+}
+
+/**
+ * Double the records table capacity. Return false on no memory.
+ */
+static bool _blks_grow(void)
+{
+    struct heap_blk *old = blks;
+    size_t i, j, old_cap = blks_cap;
+    size_t cap = (blks_cap ? 2 * blks_cap : HEAP_BLKS_INIT);
+
+    if (!(blks = (struct heap_blk*)__real_calloc(cap, sizeof(*blks)))) {
+        blks = old;
+        return false;
+    }
+    blks_cap = cap;
+
+    for (i = 0; i < old_cap; i++) {
+        if (!old[i].ptr) continue;
+
+        for (j = _blk_hash(old[i].ptr); blks[j].ptr; j = (j + 1) & (cap - 1));
+        blks[j] = old[i];
+    }
+    __real_free(old);
+    return true;
+}
+
+/**
+ * Remove record @c b from the table. Records following the removed one are
+ * shifted back to keep their probe sequences unbroken.
+ */
+static void _blk_del(struct heap_blk *b)
+{
+    size_t i = (size_t)(b - blks), j = i, k;
+
+    for (;;) {
+        j = (j + 1) & (blks_cap - 1);
+        if (!blks[j].ptr) break;
+
+        /* the record is left in place if its home slot is in (i, j] */
+        k = _blk_hash(blks[j].ptr);
+        if (i <= j ? (i < k && k <= j) : (i < k || k <= j)) continue;
+
+        blks[i] = blks[j];
+        i = j;
+    }
+    blks[i].ptr = NULL;
+    blks_n--;
+}
+
+/**
+ * Add record of accounted block @c ptr. Return false on no memory.
+ */
+static bool _blk_add(void *ptr, size_t size, const coop_mem_owner_t *owner)
+{
+    size_t i;
+    struct heap_blk *b;
+
+    if ((b = _blk_find(ptr)) != NULL) {
+        /* stale record of a block freed by a platform library directly */
+        coop_mem_uncharge(&b->owner, b->size);
+    } else {
+        /* load factor kept up to 1/2 */
+        if (2 * (blks_n + 1) > blks_cap && !_blks_grow()) {
+            return false;
+        }
+        for (i = _blk_hash(ptr); blks[i].ptr; i = (i + 1) & (blks_cap - 1));
+        b = &blks[i];
+        b->ptr = ptr;
+        blks_n++;
+    }
+    b->size = size;
+    b->owner = *owner;
+    return true;
+}
+
+void *__wrap_malloc(size_t size)
+{
+    void *blk;
+    coop_mem_owner_t owner;
+
+    if (!coop_in_thread()) {
+        return __real_malloc(size);
+    }
+
+    if (coop_mem_charge(size, &owner) != COOP_SUCCESS) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    if (!(blk = __real_malloc(size))) {
+        coop_mem_uncharge(&owner, size);
+        return NULL;
+    }
+    if (!_blk_add(blk, size, &owner)) {
+        __real_free(blk);
+        coop_mem_uncharge(&owner, size);
+        errno = ENOMEM;
+        return NULL;
+    }
+    return blk;
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+    void *blk;
+
+    if (!coop_in_thread()) {
+        return __real_calloc(nmemb, size);
+    }
+
+    if (size && nmemb > (size_t)-1 / size) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    if ((blk = __wrap_malloc(nmemb * size)) != NULL) {
+        memset(blk, 0, nmemb * size);
+    }
+    return blk;
+}
+
+void __wrap_free(void *ptr)
+{
+    struct heap_blk *b;
+
+    if (!ptr) return;
+
+    if ((b = _blk_find(ptr)) != NULL) {
+        coop_mem_uncharge(&b->owner, b->size);
+        _blk_del(b);
+    }
+    __real_free(ptr);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    void *blk;
+    struct heap_blk *b;
+    struct heap_blk old;
+    coop_mem_owner_t owner;
+
+    if (!ptr) {
+        return __wrap_malloc(size);
+    }
+    if (!(b = _blk_find(ptr))) {
+        return __real_realloc(ptr, size);
+    }
+    if (!size) {
+        __wrap_free(ptr);
+        return NULL;
+    }
+
+    /* the block is charged to the reallocating thread */
+    if (coop_mem_charge(size, &owner) != COOP_SUCCESS) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    if (!(blk = __real_realloc(ptr, size))) {
+        coop_mem_uncharge(&owner, size);
+        return NULL;
+    }
+
+    old = *b;
+    _blk_del(b);
+    coop_mem_uncharge(&old.owner, old.size);
+
+    /* the record removal makes room for the new one */
+    if (owner.thrd) _blk_add(blk, size, &owner);
+    return blk;
+}
+#endif /* CONFIG_UNIX_MALLOC_WRAP */
+#endif /* __unix__ */